@@ -0,0 +1,106 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fstream>
+#include <sstream>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+class Affinity
+{
+public:
+  struct Cpu
+  {
+    int id;
+    int socket;
+    int core;
+
+    bool operator<(const Cpu& other) const
+    {
+      if(socket != other.socket)
+        return socket < other.socket;
+      if(core != other.core)
+        return core < other.core;
+      return id < other.id;
+    }
+  };
+
+  // returns the cpus this process may run on, ordered by socket and core so that smt siblings are adjacent
+  static std::vector<Cpu> cpus()
+  {
+    std::vector<Cpu> result;
+#ifdef _WIN32
+    DWORD length = 0;
+    GetLogicalProcessorInformation(NULL, &length);
+    std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> infos(length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+    if(infos.empty() || !GetLogicalProcessorInformation(&infos[0], &length))
+      return result;
+    DWORD_PTR processMask, systemMask;
+    GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask);
+    int socket = 0, core = 0;
+    for(size_t i = 0; i < infos.size(); ++i)
+      if(infos[i].Relationship == RelationProcessorCore)
+      {
+        for(int id = 0; id < (int)sizeof(ULONG_PTR) * 8; ++id)
+          if(infos[i].ProcessorMask & processMask & ((ULONG_PTR)1 << id))
+          {
+            Cpu cpu = {id, 0, core};
+            result.push_back(cpu);
+          }
+        ++core;
+      }
+    for(size_t i = 0; i < infos.size(); ++i)
+      if(infos[i].Relationship == RelationProcessorPackage)
+      {
+        for(size_t j = 0; j < result.size(); ++j)
+          if(infos[i].ProcessorMask & ((ULONG_PTR)1 << result[j].id))
+            result[j].socket = socket;
+        ++socket;
+      }
+#else
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(sched_getaffinity(0, sizeof(set), &set) != 0)
+      return result;
+    for(int id = 0; id < CPU_SETSIZE; ++id)
+      if(CPU_ISSET(id, &set))
+      {
+        Cpu cpu = {id, readTopology(id, "physical_package_id"), readTopology(id, "core_id")};
+        result.push_back(cpu);
+      }
+#endif
+    std::sort(result.begin(), result.end());
+    return result;
+  }
+
+  static bool pin(int cpu)
+  {
+#ifdef _WIN32
+    return cpu < (int)sizeof(DWORD_PTR) * 8 && SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0;
+#else
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#endif
+  }
+
+private:
+#ifndef _WIN32
+  static int readTopology(int cpu, const char* name)
+  {
+    std::ostringstream path;
+    path << "/sys/devices/system/cpu/cpu" << cpu << "/topology/" << name;
+    std::ifstream file(path.str().c_str());
+    int value = 0;
+    file >> value;
+    return value;
+  }
+#endif
+};
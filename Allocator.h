@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+class HeapAllocator
+{
+public:
+  static const size_t alignment = 64;
+
+  // returns cache line aligned memory, the original pointer is stored in front of it
+  void* allocate(size_t size)
+  {
+    char* buffer = new char[size + alignment + sizeof(char*)];
+    char* data = (char*)(((size_t)buffer + sizeof(char*) + alignment - 1) & ~(alignment - 1));
+    ((char**)data)[-1] = buffer;
+    return data;
+  }
+
+  void deallocate(void* data, size_t) {delete [] ((char**)data)[-1];}
+};
+
+class NumaAllocator
+{
+public:
+  explicit NumaAllocator(int node = -1) : _node(node) {}
+
+  int node() const {return _node;}
+
+  // throws std::bad_alloc like HeapAllocator when the memory cannot be mapped
+  void* allocate(size_t size)
+  {
+#ifdef _WIN32
+    if(_node >= 0)
+      if(void* data = VirtualAllocExNuma(GetCurrentProcess(), NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, (DWORD)_node))
+        return data;
+    void* data = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if(!data)
+      throw std::bad_alloc();
+    return data;
+#else
+    void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(data == MAP_FAILED)
+      throw std::bad_alloc();
+    if(_node >= 0 && _node < (int)(sizeof(unsigned long) * 8))
+    {
+      // pages are not faulted in yet, so the policy decides where they land on first touch
+      unsigned long nodeMask = 1UL << _node;
+      syscall(SYS_mbind, data, size, MPOL_BIND, &nodeMask, sizeof(nodeMask) * 8, 0);
+    }
+    return data;
+#endif
+  }
+
+  void deallocate(void* data, size_t size)
+  {
+#ifdef _WIN32
+    VirtualFree(data, 0, MEM_RELEASE);
+#else
+    munmap(data, size);
+#endif
+  }
+
+private:
+  int _node;
+};
+
+class HugePageAllocator
+{
+public:
+  enum Flags
+  {
+    prefault = 0x01,
+    lock = 0x02,
+  };
+
+  static const size_t hugePageSize = 2 * 1024 * 1024;
+
+  explicit HugePageAllocator(int flags = prefault) : _flags(flags) {}
+
+  // falls back to normal pages and only throws std::bad_alloc when those cannot be mapped either
+  void* allocate(size_t size)
+  {
+    size = (size + hugePageSize - 1) & ~(hugePageSize - 1);
+#ifdef _WIN32
+    void* data = NULL;
+    SIZE_T largePageSize = GetLargePageMinimum();
+    if(largePageSize && size % largePageSize == 0)
+      data = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    if(!data)
+    {
+      data = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+      if(!data)
+        throw std::bad_alloc();
+      if(_flags & prefault)
+        touch(data, size);
+    }
+    if(_flags & lock)
+      VirtualLock(data, size);
+    return data;
+#else
+    void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (_flags & prefault ? MAP_POPULATE : 0), -1, 0);
+    if(data == MAP_FAILED)
+    {
+      // no reserved huge pages, map an aligned range and ask for transparent huge pages instead
+      char* buffer = (char*)mmap(NULL, size + hugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if(buffer == MAP_FAILED)
+        throw std::bad_alloc();
+      char* aligned = (char*)(((size_t)buffer + hugePageSize - 1) & ~(hugePageSize - 1));
+      if(aligned != buffer)
+        munmap(buffer, aligned - buffer);
+      munmap(aligned + size, buffer + hugePageSize - aligned);
+      data = aligned;
+      madvise(data, size, MADV_HUGEPAGE);
+      if(_flags & prefault)
+        touch(data, size);
+    }
+    if(_flags & lock)
+      mlock(data, size);
+    return data;
+#endif
+  }
+
+  void deallocate(void* data, size_t size)
+  {
+#ifdef _WIN32
+    VirtualFree(data, 0, MEM_RELEASE);
+#else
+    munmap(data, (size + hugePageSize - 1) & ~(hugePageSize - 1));
+#endif
+  }
+
+private:
+  int _flags;
+
+private:
+  static void touch(void* data, size_t size)
+  {
+    for(size_t i = 0; i < size; i += 4096)
+      ((volatile char*)data)[i] = 0;
+  }
+};
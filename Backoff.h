@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include "Futex.h"
+
+// waiting strategies for the timed push and pop of the queues, a queue keeps one instance of its policy
+// prepare is called before the last attempt of a round, and either cancel (the attempt succeeded) or wait follows
+// notify is called after every successful push or pop, so it has to be cheap for the policies that do not need it
+namespace Backoffs
+{
+  // pause instructions, doubling every round up to 1024 per round
+  struct Spin
+  {
+    uint32_t prepare() {return 0;}
+    void cancel() {}
+    void notify() {}
+
+    void wait(uint32_t round, uint32_t, std::chrono::nanoseconds)
+    {
+      for(uint32_t i = 0, pauses = 1u << (round < 10 ? round : 10); i < pauses; ++i)
+        Futex::pause();
+    }
+  };
+
+  // gives up the time slice after every attempt
+  struct Yield
+  {
+    uint32_t prepare() {return 0;}
+    void cancel() {}
+    void notify() {}
+    void wait(uint32_t, uint32_t, std::chrono::nanoseconds) {std::this_thread::yield();}
+  };
+
+  // sleeps for 1 microsecond, doubling every round up to 1 millisecond
+  struct Sleep
+  {
+    uint32_t prepare() {return 0;}
+    void cancel() {}
+    void notify() {}
+
+    void wait(uint32_t round, uint32_t, std::chrono::nanoseconds remaining)
+    {
+      std::chrono::nanoseconds duration = std::chrono::microseconds(round < 10 ? 1 << round : 1000);
+      std::this_thread::sleep_for(duration < remaining ? duration : remaining);
+    }
+  };
+
+  // blocks on a futex until another thread pushes or pops, as in BlockingQueue.h
+  class Park
+  {
+  public:
+    uint32_t prepare() {return _event.prepare();}
+    void cancel() {_event.cancel();}
+    void notify() {_event.notify();}
+
+    void wait(uint32_t, uint32_t epoch, std::chrono::nanoseconds remaining)
+    {
+      _event.wait(epoch, (int64_t)((remaining.count() + 999999) / 1000000));
+    }
+
+  private:
+    char cacheLinePad1[64];
+    FutexEvent _event;
+    char cacheLinePad2[64];
+  };
+
+  // repeats tryOp until it succeeds or the deadline has passed, a deadline in the past still gets one attempt
+  // tryOp must not notify the policy itself, a success is only notified once the thread no longer counts as a waiter
+  template <class B, class F, class Clock, class Duration> bool retry(B& backoff, F tryOp, const std::chrono::time_point<Clock, Duration>& deadline)
+  {
+    if(tryOp())
+    {
+      backoff.notify();
+      return true;
+    }
+    for(uint32_t round = 0;; ++round)
+    {
+      typename Clock::time_point now = Clock::now();
+      if(now >= deadline)
+        return false;
+      uint32_t ticket = backoff.prepare();
+      if(tryOp())
+      {
+        backoff.cancel();
+        backoff.notify();
+        return true;
+      }
+      backoff.wait(round, ticket, std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now));
+    }
+  }
+}
@@ -0,0 +1,116 @@
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "Futex.h"
+#include "LockFreeQueueCpp11.h"
+
+template <typename T, class Q = LockFreeQueueCpp11<T> > class BlockingQueue
+{
+public:
+  explicit BlockingQueue(size_t capacity) : _queue(capacity)
+  {
+    _spinLimit.store(minSpinLimit * 4, std::memory_order_relaxed);
+  }
+
+  size_t capacity() const {return _queue.capacity();}
+
+  size_t size() const {return _queue.size();}
+
+  size_t approx_size() const {return _queue.approx_size();}
+
+  bool push(const T& data)
+  {
+    if(!_queue.push(data))
+      return false;
+    _notEmpty.notify();
+    return true;
+  }
+
+  bool pop(T& result)
+  {
+    if(!_queue.pop(result))
+      return false;
+    _notFull.notify();
+    return true;
+  }
+
+  void push_wait(const T& data) {push_wait(data, -1);}
+
+  bool push_wait(const T& data, int64_t timeout)
+  {
+    return wait([&]() {return push(data);}, _notFull, timeout);
+  }
+
+  void pop_wait(T& result) {pop_wait(result, -1);}
+
+  bool pop_wait(T& result, int64_t timeout)
+  {
+    return wait([&]() {return pop(result);}, _notEmpty, timeout);
+  }
+
+private:
+  static const uint32_t minSpinLimit = 16;
+  static const uint32_t maxSpinLimit = 4096;
+
+private:
+  Q _queue;
+  char cacheLinePad1[64];
+  std::atomic<uint32_t> _spinLimit;
+  char cacheLinePad2[64];
+  FutexEvent _notEmpty;
+  char cacheLinePad3[64];
+  FutexEvent _notFull;
+  char cacheLinePad4[64];
+
+private:
+  template <class F> bool spin(F tryOp)
+  {
+    uint32_t limit = _spinLimit.load(std::memory_order_relaxed);
+    for(uint32_t i = 1; i <= limit; ++i)
+    {
+      Futex::pause();
+      if(tryOp())
+      {
+        if(i > limit / 2 && limit < maxSpinLimit)
+          _spinLimit.store(limit * 2, std::memory_order_relaxed);
+        return true;
+      }
+    }
+    if(limit > minSpinLimit)
+      _spinLimit.store(limit / 2, std::memory_order_relaxed);
+    return false;
+  }
+
+  template <class F> bool wait(F tryOp, FutexEvent& event, int64_t timeout)
+  {
+    if(tryOp() || spin(tryOp))
+      return true;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout < 0 ? 0 : timeout);
+    for(;;)
+    {
+      uint32_t epoch = event.prepare();
+      if(tryOp())
+      {
+        event.cancel();
+        return true;
+      }
+      int64_t remaining = -1;
+      if(timeout >= 0)
+      {
+        int64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if(micros <= 0)
+        {
+          event.cancel();
+          return false;
+        }
+        remaining = (micros + 999) / 1000;
+      }
+      event.wait(epoch, remaining);
+    }
+  }
+};
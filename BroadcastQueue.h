@@ -0,0 +1,154 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+#include "Allocator.h"
+#include "LockFreeQueueCpp11.h"
+
+// every element is seen by each of a fixed number of consumers, in the style of the LMAX disruptor
+// the slots hold default constructed elements that are assigned by push and copied out by pop
+template <typename T, class P = Producers::Multi, class A = HeapAllocator> class BroadcastQueue
+{
+public:
+  explicit BroadcastQueue(size_t capacity, size_t consumers, const A& allocator = A()) : _consumers(consumers), _allocator(allocator)
+  {
+    _capacityMask = capacity - 1;
+    for(size_t i = 1; i <= sizeof(void*) * 4; i <<= 1)
+      _capacityMask |= _capacityMask >> i;
+    _capacity = _capacityMask + 1;
+
+    _slots = (Slot*)_allocator.allocate(sizeof(Slot) * _capacity);
+    for(size_t i = 0; i < _capacity; ++i)
+    {
+      new (&_slots[i].data)T();
+      _slots[i].sequence.store(0, std::memory_order_relaxed);
+    }
+    _cursors = (Cursor*)_allocator.allocate(sizeof(Cursor) * _consumers);
+    for(size_t i = 0; i < _consumers; ++i)
+      _cursors[i].position.store(0, std::memory_order_relaxed);
+
+    _tail.store(0, std::memory_order_relaxed);
+    _gating.store(0, std::memory_order_relaxed);
+  }
+
+  ~BroadcastQueue()
+  {
+    for(size_t i = 0; i < _capacity; ++i)
+      _slots[i].data.~T();
+    _allocator.deallocate(_cursors, sizeof(Cursor) * _consumers);
+    _allocator.deallocate(_slots, sizeof(Slot) * _capacity);
+  }
+
+  size_t capacity() const {return _capacity;}
+
+  size_t consumers() const {return _consumers;}
+
+  // the number of elements the slowest consumer has not read yet
+  size_t size() const
+  {
+    size_t gating = gatingSequence();
+    return _tail.load(std::memory_order_relaxed) - gating;
+  }
+
+  size_t approx_size() const
+  {
+    size_t size = this->size();
+    return size > _capacity ? _capacity : size;
+  }
+
+  // fails when the slowest consumer is a full lap behind
+  bool push(const T& data)
+  {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    for(;;)
+    {
+      // the cursors are only scanned when the cached gating sequence does not leave room for the element
+      if((ptrdiff_t)(tail - _gating.load(std::memory_order_acquire)) >= (ptrdiff_t)_capacity)
+      {
+        size_t gating = gatingSequence();
+        _gating.store(gating, std::memory_order_release);
+        if((ptrdiff_t)(tail - gating) >= (ptrdiff_t)_capacity)
+          return false;
+      }
+      if(advance<P>(_tail, tail, tail + 1))
+        break;
+    }
+    Slot& slot = _slots[tail & _capacityMask];
+    slot.data = data;
+    slot.sequence.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(size_t consumer, T& result) {return pop_bulk(consumer, &result, 1) != 0;}
+
+  // copies up to max of the published elements the consumer has not read yet, and advances its cursor once
+  size_t pop_bulk(size_t consumer, T* result, size_t max)
+  {
+    std::atomic<size_t>& cursor = _cursors[consumer].position;
+    size_t position = cursor.load(std::memory_order_relaxed);
+    size_t count = 0;
+    for(; count < max; ++count)
+    {
+      Slot& slot = _slots[(position + count) & _capacityMask];
+      if(slot.sequence.load(std::memory_order_acquire) != position + count + 1)
+        break;
+      result[count] = slot.data;
+    }
+    if(count)
+      cursor.store(position + count, std::memory_order_release);
+    return count;
+  }
+
+private:
+  struct Slot
+  {
+    std::atomic<size_t> sequence;
+    T data;
+  };
+
+  // every consumer writes its cursor to a cache line of its own
+  struct Cursor
+  {
+    std::atomic<size_t> position;
+    char cacheLinePad[64 - sizeof(std::atomic<size_t>)];
+  };
+
+private:
+  size_t _capacityMask;
+  size_t _capacity;
+  size_t _consumers;
+  Slot* _slots;
+  Cursor* _cursors;
+  A _allocator;
+  char cacheLinePad1[64];
+  std::atomic<size_t> _tail;
+  char cacheLinePad2[64];
+  std::atomic<size_t> _gating;
+  char cacheLinePad3[64];
+
+private:
+  size_t gatingSequence() const
+  {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    size_t gating = tail;
+    for(size_t i = 0; i < _consumers; ++i)
+    {
+      size_t position = _cursors[i].position.load(std::memory_order_acquire);
+      if((ptrdiff_t)(position - gating) < 0)
+        gating = position;
+    }
+    return gating;
+  }
+
+  template <class M> static bool advance(std::atomic<size_t>& index, size_t& value, size_t next)
+  {
+    if(!M::multi)
+    {
+      index.store(next, std::memory_order_relaxed);
+      return true;
+    }
+    return index.compare_exchange_weak(value, next, std::memory_order_relaxed);
+  }
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <thread>
+
+#include "CountedQueue.h"
+#include "LockFreeQueueCpp11.h"
+
+// keeps only the latest value of each key queued, keys are the indices 0 to keys-1
+// the queue holds every key at most once, so pushes never fail and the key order is the order of their first pending push
+template <typename T, class Q = LockFreeQueueCpp11<size_t> > class ConflatingQueue
+{
+public:
+  explicit ConflatingQueue(size_t keys) : _keys(keys), _queue(keys)
+  {
+    _entries = (Entry*)::operator new(sizeof(Entry) * keys);
+    for(size_t i = 0; i < keys; ++i)
+    {
+      Entry& entry = _entries[i];
+      new (&entry.value)T();
+      entry.locked.store(false, std::memory_order_relaxed);
+      entry.queued = false;
+    }
+  }
+
+  ~ConflatingQueue()
+  {
+    for(size_t i = 0; i < _keys; ++i)
+      _entries[i].value.~T();
+    ::operator delete(_entries);
+  }
+
+  size_t keys() const {return _keys;}
+
+  size_t capacity() const {return _keys;}
+
+  size_t size() const {return _queue.size();}
+
+  size_t approx_size() const {return _queue.approx_size();}
+
+  // the number of values that were replaced by a newer value of the same key before they were popped
+  size_t drops() const
+  {
+    ptrdiff_t drops = _drops.sum();
+    return drops > 0 ? (size_t)drops : 0;
+  }
+
+  bool push(size_t key, const T& data)
+  {
+    Entry& entry = _entries[key];
+    lock(entry);
+    entry.value = data;
+    bool queued = entry.queued;
+    entry.queued = true;
+    entry.locked.store(false, std::memory_order_release);
+    if(queued)
+      _drops.add(1);
+    else
+      // the ring has room for every key, but a slot may not have been released by a consumer yet
+      while(!_queue.push(key))
+        std::this_thread::yield();
+    return true;
+  }
+
+  bool pop(size_t& key, T& result)
+  {
+    if(!_queue.pop(key))
+      return false;
+    Entry& entry = _entries[key];
+    lock(entry);
+    result = entry.value;
+    entry.queued = false;
+    entry.locked.store(false, std::memory_order_release);
+    return true;
+  }
+
+private:
+  struct Entry
+  {
+    std::atomic<bool> locked;
+    bool queued;
+    T value;
+  };
+
+private:
+  size_t _keys;
+  Entry* _entries;
+  Q _queue;
+  StripedCounter<> _drops;
+
+private:
+  // an entry is only locked while a value is copied in or out, a waiter yields in case the owner was preempted
+  static void lock(Entry& entry)
+  {
+    while(entry.locked.exchange(true, std::memory_order_acquire))
+      while(entry.locked.load(std::memory_order_relaxed))
+        std::this_thread::yield();
+  }
+};
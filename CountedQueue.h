@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+#include "LockFreeQueueCpp11.h"
+
+// a counter split into cache line sized stripes, each thread only adds to its own stripe
+template <size_t N = 16> class StripedCounter
+{
+public:
+  StripedCounter()
+  {
+    for(size_t i = 0; i < N; ++i)
+      _stripes[i].value.store(0, std::memory_order_relaxed);
+  }
+
+  void add(ptrdiff_t value) {_stripes[stripe()].value.fetch_add(value, std::memory_order_relaxed);}
+
+  ptrdiff_t sum() const
+  {
+    ptrdiff_t sum = 0;
+    for(size_t i = 0; i < N; ++i)
+      sum += _stripes[i].value.load(std::memory_order_relaxed);
+    return sum;
+  }
+
+private:
+  struct Stripe
+  {
+    std::atomic<ptrdiff_t> value;
+    char cacheLinePad[64 - sizeof(std::atomic<ptrdiff_t>)];
+  };
+
+private:
+  char cacheLinePad1[64];
+  Stripe _stripes[N];
+
+private:
+  static size_t stripe()
+  {
+    static std::atomic<size_t> threads(0);
+    static thread_local size_t stripe = threads.fetch_add(1, std::memory_order_relaxed) % N;
+    return stripe;
+  }
+};
+
+// counts successful pushes and pops in a StripedCounter, so size() is exact whenever no push or pop is in progress
+template <typename T, class Q = LockFreeQueueCpp11<T>, size_t N = 16> class CountedQueue
+{
+public:
+  explicit CountedQueue(size_t capacity) : _queue(capacity) {}
+
+  size_t capacity() const {return _queue.capacity();}
+
+  size_t size() const
+  {
+    ptrdiff_t size = _count.sum();
+    return size > 0 ? (size_t)size : 0;
+  }
+
+  size_t approx_size() const {return _queue.approx_size();}
+
+  bool push(const T& data)
+  {
+    if(!_queue.push(data))
+      return false;
+    _count.add(1);
+    return true;
+  }
+
+  bool pop(T& result)
+  {
+    if(!_queue.pop(result))
+      return false;
+    _count.add(-1);
+    return true;
+  }
+
+private:
+  Q _queue;
+  StripedCounter<N> _count;
+};
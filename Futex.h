@@ -0,0 +1,95 @@
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <windows.h>
+#pragma comment(lib, "Synchronization.lib")
+#else
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+class Futex
+{
+public:
+  static void wait(std::atomic<uint32_t>& word, uint32_t value, int64_t timeout = -1)
+  {
+#ifdef _WIN32
+    WaitOnAddress(&word, &value, sizeof(value), timeout < 0 ? INFINITE : (DWORD)timeout);
+#else
+    struct timespec ts;
+    ts.tv_sec = (time_t)(timeout / 1000);
+    ts.tv_nsec = (long)(timeout % 1000) * 1000000L;
+    syscall(SYS_futex, (uint32_t*)&word, FUTEX_WAIT_PRIVATE, value, timeout < 0 ? (struct timespec*)0 : &ts, (uint32_t*)0, 0);
+#endif
+  }
+
+  static void wakeAll(std::atomic<uint32_t>& word)
+  {
+#ifdef _WIN32
+    WakeByAddressAll(&word);
+#else
+    syscall(SYS_futex, (uint32_t*)&word, FUTEX_WAKE_PRIVATE, INT_MAX, (struct timespec*)0, (uint32_t*)0, 0);
+#endif
+  }
+
+  static void pause()
+  {
+#if defined(_MSC_VER)
+    YieldProcessor();
+#elif defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+  }
+};
+
+// a futex word that is only bumped and woken while a thread waits on it, for waking threads that block on a condition
+// prepare registers the calling thread as a waiter, and the condition has to be checked again before wait parks it
+class FutexEvent
+{
+public:
+  FutexEvent()
+  {
+    _epoch.store(0, std::memory_order_relaxed);
+    _waiters.store(0, std::memory_order_relaxed);
+  }
+
+  uint32_t prepare()
+  {
+    uint32_t epoch = _epoch.load(std::memory_order_acquire);
+    _waiters.fetch_add(1, std::memory_order_seq_cst);
+    // pairs with the fence in notify, so either the check after prepare sees the other side's operation or notify sees the waiter
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return epoch;
+  }
+
+  void cancel() {_waiters.fetch_sub(1, std::memory_order_relaxed);}
+
+  void wait(uint32_t epoch, int64_t timeout = -1)
+  {
+    Futex::wait(_epoch, epoch, timeout);
+    _waiters.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  void notify()
+  {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(_waiters.load(std::memory_order_relaxed))
+    {
+      _epoch.fetch_add(1, std::memory_order_release);
+      Futex::wakeAll(_epoch);
+    }
+  }
+
+private:
+  std::atomic<uint32_t> _epoch;
+  std::atomic<uint32_t> _waiters;
+};
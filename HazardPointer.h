@@ -0,0 +1,136 @@
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+class HazardPointer
+{
+public:
+  static const size_t slots = 2;
+
+  template <typename T> static T* protect(const std::atomic<T*>& source, size_t slot = 0)
+  {
+    std::atomic<void*>& hazard = localRecord()->hazards[slot];
+    T* pointer = source.load(std::memory_order_relaxed);
+    for(;;)
+    {
+      hazard.store(pointer, std::memory_order_seq_cst);
+      T* current = source.load(std::memory_order_seq_cst);
+      if(current == pointer)
+        return pointer;
+      pointer = current;
+    }
+  }
+
+  static void clear()
+  {
+    Record* record = localRecord();
+    for(size_t i = 0; i < slots; ++i)
+      record->hazards[i].store(nullptr, std::memory_order_release);
+  }
+
+  template <typename T> static void retire(T* pointer)
+  {
+    Record* record = localRecord();
+    Retired retired = {pointer, &destroy<T>};
+    record->retired.push_back(retired);
+    if(record->retired.size() >= recordCount().load(std::memory_order_relaxed) * slots * 2 + 16)
+      scan(record);
+  }
+
+private:
+  struct Retired
+  {
+    void* pointer;
+    void (*destroy)(void*);
+  };
+
+  struct Record
+  {
+    std::atomic<void*> hazards[slots];
+    std::atomic<bool> active;
+    Record* next;
+    std::vector<Retired> retired;
+  };
+
+  struct LocalRecord
+  {
+    Record* record;
+
+    LocalRecord() : record(acquire()) {}
+    ~LocalRecord() {release(record);}
+  };
+
+private:
+  template <typename T> static void destroy(void* pointer) {delete (T*)pointer;}
+
+  static std::atomic<Record*>& records()
+  {
+    static std::atomic<Record*> records(nullptr);
+    return records;
+  }
+
+  static std::atomic<size_t>& recordCount()
+  {
+    static std::atomic<size_t> recordCount(0);
+    return recordCount;
+  }
+
+  static Record* localRecord()
+  {
+    static thread_local LocalRecord localRecord;
+    return localRecord.record;
+  }
+
+  static Record* acquire()
+  {
+    for(Record* record = records().load(std::memory_order_acquire); record; record = record->next)
+    {
+      bool active = false;
+      if(!record->active.load(std::memory_order_relaxed) && record->active.compare_exchange_strong(active, true, std::memory_order_acquire))
+        return record;
+    }
+    Record* record = new Record;
+    for(size_t i = 0; i < slots; ++i)
+      record->hazards[i].store(nullptr, std::memory_order_relaxed);
+    record->active.store(true, std::memory_order_relaxed);
+    Record* head = records().load(std::memory_order_relaxed);
+    do
+      record->next = head;
+    while(!records().compare_exchange_weak(head, record, std::memory_order_release, std::memory_order_relaxed));
+    recordCount().fetch_add(1, std::memory_order_relaxed);
+    return record;
+  }
+
+  static void release(Record* record)
+  {
+    for(size_t i = 0; i < slots; ++i)
+      record->hazards[i].store(nullptr, std::memory_order_release);
+    scan(record);
+    record->active.store(false, std::memory_order_release);
+  }
+
+  static void scan(Record* record)
+  {
+    std::vector<void*> hazards;
+    for(Record* i = records().load(std::memory_order_acquire); i; i = i->next)
+      for(size_t j = 0; j < slots; ++j)
+      {
+        void* pointer = i->hazards[j].load(std::memory_order_seq_cst);
+        if(pointer)
+          hazards.push_back(pointer);
+      }
+    std::sort(hazards.begin(), hazards.end());
+
+    std::vector<Retired> retired;
+    retired.swap(record->retired);
+    for(std::vector<Retired>::iterator i = retired.begin(), end = retired.end(); i != end; ++i)
+      if(std::binary_search(hazards.begin(), hazards.end(), i->pointer))
+        record->retired.push_back(*i);
+      else
+        i->destroy(i->pointer);
+  }
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+class CycleClock
+{
+public:
+  static uint64_t now()
+  {
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+    return __rdtsc();
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+  }
+
+  static double nanosecondsPerTick()
+  {
+    static const double value = calibrate();
+    return value;
+  }
+
+private:
+  static double calibrate()
+  {
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point startTime = Clock::now();
+    uint64_t startTicks = now();
+    while(Clock::now() - startTime < std::chrono::milliseconds(20));
+    uint64_t ticks = now() - startTicks;
+    double nanoseconds = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - startTime).count();
+    return ticks ? nanoseconds / (double)ticks : 1.;
+#else
+    return 1.;
+#endif
+  }
+};
+
+class LatencyHistogram
+{
+public:
+  LatencyHistogram() {reset();}
+
+  void reset()
+  {
+    std::memset(_buckets, 0, sizeof(_buckets));
+    _count = 0;
+    _max = 0;
+  }
+
+  void record(uint64_t value)
+  {
+    ++_buckets[bucket(value)];
+    ++_count;
+    if(value > _max)
+      _max = value;
+  }
+
+  void merge(const LatencyHistogram& other)
+  {
+    for(size_t i = 0; i < bucketCount; ++i)
+      _buckets[i] += other._buckets[i];
+    _count += other._count;
+    if(other._max > _max)
+      _max = other._max;
+  }
+
+  uint64_t count() const {return _count;}
+  uint64_t maximum() const {return _max;}
+
+  uint64_t percentile(double percent) const
+  {
+    if(!_count)
+      return 0;
+    uint64_t rank = (uint64_t)std::ceil(percent / 100. * (double)_count);
+    if(!rank)
+      rank = 1;
+    uint64_t sum = 0;
+    for(size_t i = 0; i < bucketCount; ++i)
+      if((sum += _buckets[i]) >= rank)
+      {
+        uint64_t value = highestValue(i);
+        return value < _max ? value : _max;
+      }
+    return _max;
+  }
+
+private:
+  static const int subBucketBits = 7;
+  static const size_t subBucketHalfCount = (size_t)1 << (subBucketBits - 1);
+  static const size_t bucketCount = (64 - subBucketBits + 2) * subBucketHalfCount;
+
+private:
+  uint64_t _buckets[bucketCount];
+  uint64_t _count;
+  uint64_t _max;
+
+private:
+  static size_t bucket(uint64_t value)
+  {
+    if(value < (subBucketHalfCount << 1))
+      return (size_t)value;
+    int shift = highestBit(value) - (subBucketBits - 1);
+    return (size_t)shift * subBucketHalfCount + (size_t)(value >> shift);
+  }
+
+  static uint64_t highestValue(size_t bucket)
+  {
+    if(bucket < (subBucketHalfCount << 1))
+      return bucket;
+    size_t shift = bucket / subBucketHalfCount - 1;
+    uint64_t subBucket = bucket - shift * subBucketHalfCount;
+    return ((subBucket + 1) << shift) - 1;
+  }
+
+  static int highestBit(uint64_t value)
+  {
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return (int)index;
+#elif defined(_MSC_VER)
+    int index = 0;
+    while(value >>= 1)
+      ++index;
+    return index;
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+  }
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+
+namespace Layouts
+{
+  struct Packed {static const bool padded = false; static const bool remapped = false;};
+  struct Padded {static const bool padded = true; static const bool remapped = false;};
+  struct Remapped {static const bool padded = false; static const bool remapped = true;};
+}
+
+template <class L, size_t N> struct NodeLayout
+{
+  static const size_t cacheLineSize = 64;
+  static const size_t stride = L::padded ? (N + cacheLineSize - 1) & ~(cacheLineSize - 1) : N;
+
+  // number of low index bits that are swapped with the bits above them so that consecutive indices are a cache line apart
+  static size_t remapBits(size_t capacity)
+  {
+    size_t bits = 0;
+    if(L::remapped)
+      while((stride << bits) < cacheLineSize && ((size_t)4 << (bits * 2)) <= capacity)
+        ++bits;
+    return bits;
+  }
+
+  static size_t slot(size_t index, size_t remapBits)
+  {
+    if(L::remapped)
+    {
+      size_t mix = (index ^ (index >> remapBits)) & (((size_t)1 << remapBits) - 1);
+      index ^= mix | (mix << remapBits);
+    }
+    return index;
+  }
+};
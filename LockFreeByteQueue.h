@@ -0,0 +1,195 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+#include "Allocator.h"
+#include "LockFreeQueueCpp11.h"
+
+template <class P = Producers::Multi, class C = Consumers::Multi, class A = HeapAllocator> class LockFreeByteQueue
+{
+public:
+  static const size_t cellSize = 16;
+
+  // capacity is given in bytes and rounded up to a power of two
+  explicit LockFreeByteQueue(size_t capacity, const A& allocator = A()) : _allocator(allocator)
+  {
+    _cellMask = (capacity + cellSize - 1) / cellSize - 1;
+    for(size_t i = 1; i <= sizeof(void*) * 4; i <<= 1)
+      _cellMask |= _cellMask >> i;
+    _cellCount = _cellMask + 1;
+
+    _buffer = (char*)_allocator.allocate(cellSize * _cellCount);
+    _cells = (Cell*)_allocator.allocate(sizeof(Cell) * _cellCount);
+    for(size_t i = 0; i < _cellCount; ++i)
+    {
+      _cells[i].sequence.store(0, std::memory_order_relaxed);
+      _cells[i].size.store(0, std::memory_order_relaxed);
+    }
+
+    _tail.store(0, std::memory_order_relaxed);
+    _head.store(0, std::memory_order_relaxed);
+    _headReleased.store(0, std::memory_order_relaxed);
+  }
+
+  ~LockFreeByteQueue()
+  {
+    _allocator.deallocate(_cells, sizeof(Cell) * _cellCount);
+    _allocator.deallocate(_buffer, cellSize * _cellCount);
+  }
+
+  size_t capacity() const {return cellSize * _cellCount;}
+
+  // records up to this size can always be reserved once enough of the ring has been released
+  size_t maxSize() const {return cellSize * _cellCount / 2;}
+
+  size_t size() const
+  {
+    size_t headReleased = _headReleased.load(std::memory_order_acquire);
+    return cellSize * (_tail.load(std::memory_order_relaxed) - headReleased);
+  }
+
+  size_t approx_size() const
+  {
+    size_t headReleased = _headReleased.load(std::memory_order_relaxed);
+    ptrdiff_t cells = (ptrdiff_t)(_tail.load(std::memory_order_relaxed) - headReleased);
+    return cells <= 0 ? 0 : cellSize * ((size_t)cells > _cellCount ? _cellCount : (size_t)cells);
+  }
+
+  // reserves a contiguous, 16 byte aligned record of the given size that has to be passed to commit once it is written
+  void* reserve(size_t size)
+  {
+    size_t cells = cellCount(size);
+    if(cells > _cellCount / 2)
+      return 0;
+    size_t padding;
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    for(;;)
+    {
+      // a record that would cross the end of the buffer is preceded by a padding record up to the end
+      size_t offset = tail & _cellMask;
+      padding = offset + cells > _cellCount ? _cellCount - offset : 0;
+      if(tail + padding + cells > _headReleased.load(std::memory_order_acquire) + _cellCount)
+        return 0;
+      if(advance<P>(_tail, tail, tail + padding + cells))
+        break;
+    }
+    if(padding)
+    {
+      Cell& cell = _cells[tail & _cellMask];
+      cell.size.store(paddingFlag | (cellSize * padding), std::memory_order_relaxed);
+      cell.sequence.store(stamp(tail, committed), std::memory_order_release);
+      tail += padding;
+    }
+    Cell& cell = _cells[tail & _cellMask];
+    cell.size.store(size, std::memory_order_relaxed);
+    cell.sequence.store(stamp(tail, reserved), std::memory_order_relaxed);
+    return _buffer + cellSize * (tail & _cellMask);
+  }
+
+  void commit(void* data)
+  {
+    Cell& cell = cellOf(data);
+    cell.sequence.store((cell.sequence.load(std::memory_order_relaxed) & ~stateMask) | committed, std::memory_order_release);
+  }
+
+  // returns the oldest committed record, which stays valid until it is passed to release
+  const void* read(size_t& size)
+  {
+    size_t head = _head.load(std::memory_order_relaxed);
+    for(;;)
+    {
+      Cell& cell = _cells[head & _cellMask];
+      size_t sequence = cell.sequence.load(std::memory_order_acquire);
+      if(sequence != stamp(head, committed))
+      {
+        // a newer or released stamp means that another consumer has already taken the record at head
+        if((sequence >> stateBits) < head || ((sequence >> stateBits) == head && (sequence & stateMask) != released))
+          return 0;
+        head = _head.load(std::memory_order_relaxed);
+        continue;
+      }
+      size_t recordSize = cell.size.load(std::memory_order_relaxed);
+      size_t next = head + cellCount(recordSize & ~paddingFlag);
+      if(!advance<C>(_head, head, next))
+        continue;
+      if(recordSize & paddingFlag)
+      {
+        releaseCell(cell);
+        head = next;
+        continue;
+      }
+      size = recordSize;
+      return _buffer + cellSize * (head & _cellMask);
+    }
+  }
+
+  // records may be released in any order, the space is reclaimed in ring order
+  void release(const void* data) {releaseCell(cellOf(data));}
+
+private:
+  enum State
+  {
+    reserved = 1,
+    committed = 2,
+    released = 3,
+  };
+
+  static const size_t stateBits = 2;
+  static const size_t stateMask = (1 << stateBits) - 1;
+  static const size_t paddingFlag = (size_t)1 << (sizeof(size_t) * 8 - 1);
+
+  struct Cell
+  {
+    std::atomic<size_t> sequence;
+    std::atomic<size_t> size;
+  };
+
+private:
+  size_t _cellMask;
+  size_t _cellCount;
+  char* _buffer;
+  Cell* _cells;
+  A _allocator;
+  char cacheLinePad1[64];
+  std::atomic<size_t> _tail;
+  char cacheLinePad2[64];
+  std::atomic<size_t> _head;
+  char cacheLinePad3[64];
+  std::atomic<size_t> _headReleased;
+  char cacheLinePad4[64];
+
+private:
+  static size_t stamp(size_t position, State state) {return position << stateBits | state;}
+
+  static size_t cellCount(size_t size) {return size ? (size + cellSize - 1) / cellSize : 1;}
+
+  Cell& cellOf(const void* data) {return _cells[((const char*)data - _buffer) / cellSize];}
+
+  void releaseCell(Cell& cell)
+  {
+    // sequentially consistent, so that either this thread or the one releasing the record in front of this one sees both releases
+    cell.sequence.store((cell.sequence.load(std::memory_order_relaxed) & ~stateMask) | released, std::memory_order_seq_cst);
+    size_t headReleased = _headReleased.load(std::memory_order_seq_cst);
+    for(;;)
+    {
+      Cell& next = _cells[headReleased & _cellMask];
+      if(next.sequence.load(std::memory_order_seq_cst) != stamp(headReleased, released))
+        return;
+      size_t recordSize = next.size.load(std::memory_order_relaxed);
+      size_t nextReleased = headReleased + cellCount(recordSize & ~paddingFlag);
+      if(_headReleased.compare_exchange_weak(headReleased, nextReleased, std::memory_order_seq_cst))
+        headReleased = nextReleased;
+    }
+  }
+
+  template <class M> static bool advance(std::atomic<size_t>& index, size_t& value, size_t next)
+  {
+    if(!M::multi)
+    {
+      index.store(next, std::memory_order_relaxed);
+      return true;
+    }
+    return index.compare_exchange_weak(value, next, std::memory_order_relaxed);
+  }
+};
@@ -4,7 +4,8 @@
 #include <nstd/Atomic.h>
 #include <nstd/Memory.h>
 
-template <typename T> class LockFreeLifoQueue
+// E is the number of elimination slots (0 disables elimination), W the number of spins a push or pop waits in a slot
+template <typename T, usize E = 0, usize W = 64> class LockFreeLifoQueue
 {
 public:
   explicit LockFreeLifoQueue(usize capacity)
@@ -22,6 +23,10 @@ public:
       node.abaNextFree = ++i;
     }
     _queue[capacity].abaNextFree = 0;
+    _queue[0].depth = 0;
+
+    for(usize i = 0; i < E; ++i)
+      _eliminations[i].abaPushed = 0;
 
     _abaFree = 1;
     _abaPushed = 0;
@@ -44,7 +49,15 @@ public:
   
   usize capacity() const {return _capacity;}
 
-  usize size() const {return 0;}
+  // the depth of a node does not change while it is on the stack, so the top node knows the size
+  // the top node can be popped and pushed again with another depth while it is read, so a racing size can be off
+  usize size() const {return _queue[_abaPushed & _indexMask].depth;}
+
+  usize approx_size() const
+  {
+    usize size = this->size();
+    return size > _capacity ? _capacity : size;
+  }
 
   bool push(const T& data)
   {
@@ -66,8 +79,11 @@ public:
     {
       usize abaPushed = _abaPushed;
       node->abaNextPushed = abaPushed;
+      node->depth = _queue[abaPushed & _indexMask].depth + 1;
       if(Atomic::compareAndSwap(_abaPushed, abaPushed, abaFree) == abaPushed)
         return true;
+      if(E && eliminatePush(abaFree))
+        return true;
     }
   }
 
@@ -84,6 +100,11 @@ public:
       node = &_queue[nodeIndex];
       if(Atomic::compareAndSwap(_abaPushed, abaPushed, node->abaNextPushed + _abaOffset) == abaPushed)
         break;
+      if(E && (abaPushed = eliminatePop()))
+      {
+        node = &_queue[abaPushed & _indexMask];
+        break;
+      }
     }
 
     result = node->data;
@@ -104,6 +125,14 @@ private:
     T data;
     volatile usize abaNextFree;
     volatile usize abaNextPushed;
+    volatile usize depth;
+  };
+
+  // a slot holds the node of a waiting push, a colliding pop takes it over without touching the stack
+  struct Elimination
+  {
+    volatile usize abaPushed;
+    char cacheLinePad[64 - sizeof(usize)];
   };
 
 private:
@@ -116,4 +145,38 @@ private:
   char cacheLinePad2[64];
   volatile usize _abaPushed;
   char cacheLinePad3[64];
+  Elimination _eliminations[E ? E : 1];
+
+private:
+  static usize random()
+  {
+    static thread_local uint32 state = (uint32)(usize)&state | 1;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  bool eliminatePush(usize abaNode)
+  {
+    volatile usize& slot = _eliminations[random() % E].abaPushed;
+    if(slot || Atomic::compareAndSwap(slot, 0, abaNode) != 0)
+      return false;
+    for(usize i = 0; i < W; ++i)
+      if(slot != abaNode)
+        return true;
+    return Atomic::compareAndSwap(slot, abaNode, 0) != abaNode;
+  }
+
+  usize eliminatePop()
+  {
+    volatile usize& slot = _eliminations[random() % E].abaPushed;
+    for(usize i = 0; i < W; ++i)
+    {
+      usize abaNode = slot;
+      if(abaNode && Atomic::compareAndSwap(slot, abaNode, 0) == abaNode)
+        return abaNode;
+    }
+    return 0;
+  }
 };
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <nstd/Atomic.h>
+#include <nstd/Memory.h>
+
+#include <utility>
+
+template <typename T, usize M = 32, usize N = 64> class LockFreeObjectPool
+{
+public:
+  static const usize magazineSize = M;
+  static const usize magazineCount = N;
+
+  static_assert(M >= 2, "a magazine is refilled and flushed by half its size, so it needs room for at least two objects");
+
+  explicit LockFreeObjectPool(usize capacity)
+    : _capacity(capacity)
+  {
+    _indexMask = capacity;
+    for(usize i = 1; i <= sizeof(void*) * 4; i <<= 1)
+      _indexMask |= _indexMask >> i;
+    _abaOffset = _indexMask + 1;
+
+    _nodes = (Node*)Memory::alloc(sizeof(Node) * (capacity + 1));
+    for(usize i = 1; i < capacity;)
+    {
+      Node& node = _nodes[i];
+      node.abaNextFree = ++i;
+    }
+    _nodes[capacity].abaNextFree = 0;
+
+    _magazines = (Magazine*)Memory::alloc(sizeof(Magazine) * N);
+    for(usize i = 0; i < N; ++i)
+    {
+      _magazines[i].busy = 0;
+      _magazines[i].count = 0;
+    }
+
+    _abaFree = capacity ? 1 : 0;
+  }
+
+  ~LockFreeObjectPool()
+  {
+    Memory::free(_magazines);
+    Memory::free(_nodes);
+  }
+
+  usize capacity() const {return _capacity;}
+
+  // returns uninitialized storage for a T or 0 if the pool is exhausted
+  // the shared stack running empty flushes the magazines of the other threads, even of those that have exited, before giving up
+  T* allocate()
+  {
+    Magazine& magazine = _magazines[thread() % N];
+    if(Atomic::swap(magazine.busy, 1) == 0)
+    {
+      if(!magazine.count && !(magazine.count = popFree(magazine.items, M / 2)) && flushMagazines())
+        magazine.count = popFree(magazine.items, M / 2);
+      T* data = magazine.count ? &_nodes[magazine.items[--magazine.count]].data : 0;
+      Atomic::store(magazine.busy, 0);
+      return data;
+    }
+    usize index;
+    if(popFree(&index, 1) || (flushMagazines() && popFree(&index, 1)))
+      return &_nodes[index].data;
+    return 0;
+  }
+
+  void deallocate(T* data)
+  {
+    usize index = (Node*)data - _nodes;
+    Magazine& magazine = _magazines[thread() % N];
+    if(Atomic::swap(magazine.busy, 1) == 0)
+    {
+      if(magazine.count == M)
+      {
+        magazine.count -= M / 2;
+        pushFree(magazine.items + magazine.count, M / 2);
+      }
+      magazine.items[magazine.count++] = index;
+      Atomic::store(magazine.busy, 0);
+      return;
+    }
+    pushFree(&index, 1);
+  }
+
+  template <typename... Args> T* create(Args&&... args)
+  {
+    T* data = allocate();
+    if(data)
+      new (data)T(std::forward<Args>(args)...);
+    return data;
+  }
+
+  void destroy(T* data)
+  {
+    data->~T();
+    deallocate(data);
+  }
+
+private:
+  struct Node
+  {
+    T data;
+    volatile usize abaNextFree;
+    usize aba;
+  };
+
+  // a thread owns its magazine while busy is set, a thread finding it taken falls back to the shared stack
+  struct Magazine
+  {
+    volatile int32 busy;
+    usize count;
+    usize items[M];
+    char cacheLinePad[64];
+  };
+
+private:
+  usize _indexMask;
+  Node* _nodes;
+  Magazine* _magazines;
+  usize _abaOffset;
+  usize _capacity;
+  char cacheLinePad1[64];
+  volatile usize _abaFree;
+  char cacheLinePad2[64];
+
+private:
+  static usize thread()
+  {
+    static volatile usize threads = 0;
+    static thread_local usize thread = Atomic::increment(threads);
+    return thread;
+  }
+
+  // moves the objects of every magazine that is not in use to the shared stack, returns whether there were any
+  bool flushMagazines()
+  {
+    bool flushed = false;
+    for(usize i = 0; i < N; ++i)
+    {
+      Magazine& magazine = _magazines[i];
+      if(Atomic::swap(magazine.busy, 1) == 0)
+      {
+        if(magazine.count)
+        {
+          pushFree(magazine.items, magazine.count);
+          magazine.count = 0;
+          flushed = true;
+        }
+        Atomic::store(magazine.busy, 0);
+      }
+    }
+    return flushed;
+  }
+
+  // takes up to n nodes off the free stack with a single compare-and-swap
+  usize popFree(usize* indices, usize n)
+  {
+    for(;;)
+    {
+      usize abaFree = _abaFree;
+      usize abaNext = abaFree;
+      usize count = 0;
+      for(usize nodeIndex; count < n && (nodeIndex = abaNext & _indexMask); ++count)
+      {
+        indices[count] = nodeIndex;
+        abaNext = _nodes[nodeIndex].abaNextFree;
+      }
+      if(!count)
+        return 0;
+      if(Atomic::compareAndSwap(_abaFree, abaFree, abaNext) == abaFree)
+      {
+        // the chain cannot have changed while the stack top kept its tag, so each node remembers the tag it was linked with
+        for(usize i = 0, aba = abaFree; i < count; ++i)
+        {
+          Node& node = _nodes[indices[i]];
+          node.aba = aba;
+          aba = node.abaNextFree;
+        }
+        return count;
+      }
+    }
+  }
+
+  // links n nodes into a chain and pushes it with a single compare-and-swap, every push moves a node to a new aba tag
+  void pushFree(const usize* indices, usize n)
+  {
+    for(usize i = 0; i < n; ++i)
+    {
+      Node& node = _nodes[indices[i]];
+      node.aba += _abaOffset;
+      if(i)
+        _nodes[indices[i - 1]].abaNextFree = node.aba;
+    }
+    Node& last = _nodes[indices[n - 1]];
+    usize abaFirst = _nodes[indices[0]].aba;
+    for(;;)
+    {
+      usize abaFree = _abaFree;
+      last.abaNextFree = abaFree;
+      if(Atomic::compareAndSwap(_abaFree, abaFree, abaFirst) == abaFree)
+        return;
+    }
+  }
+};
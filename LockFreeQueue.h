@@ -4,7 +4,9 @@
 #include <nstd/Atomic.h>
 #include <nstd/Memory.h>
 
-template <typename T> class LockFreeQueue
+#include "Layout.h"
+
+template <typename T, class L = Layouts::Packed> class LockFreeQueue
 {
 public:
   explicit LockFreeQueue(usize capacity)
@@ -14,11 +16,13 @@ public:
       _capacityMask |= _capacityMask >> i;
     _capacity = _capacityMask + 1;
 
-    _queue = (Node*)Memory::alloc(sizeof(Node) * _capacity);
+    _remapBits = Layout::remapBits(_capacity);
+    _buffer = Memory::alloc(Layout::stride * _capacity + Layout::cacheLineSize);
+    _queue = (char*)(((usize)_buffer + Layout::cacheLineSize - 1) & ~(usize)(Layout::cacheLineSize - 1));
     for(usize i = 0; i < _capacity; ++i)
     {
-      _queue[i].tail = i;
-      _queue[i].head = -1;
+      node(i)->tail = i;
+      node(i)->head = -1;
     }
 
     _tail = 0;
@@ -28,9 +32,9 @@ public:
   ~LockFreeQueue()
   {
     for(usize i = _head; i != _tail; ++i)
-      (&_queue[i & _capacityMask].data)->~T();
+      (&node(i)->data)->~T();
 
-    Memory::free(_queue);
+    Memory::free(_buffer);
   }
   
   usize capacity() const {return _capacity;}
@@ -40,6 +44,13 @@ public:
     usize head = Atomic::load(_head);
     return _tail - head;
   }
+
+  usize approx_size() const
+  {
+    usize head = Atomic::load(_head);
+    usize size = Atomic::load(_tail) - head;
+    return (ssize)size <= 0 ? 0 : size > _capacity ? _capacity : size;
+  }
   
   bool push(const T& data)
   {
@@ -47,7 +58,7 @@ public:
     usize next, tail = _tail;
     for(;; tail = next)
     {
-      node = &_queue[tail & _capacityMask];
+      node = this->node(tail);
       if(Atomic::load(node->tail) != tail)
         return false;
       if((next = Atomic::compareAndSwap(_tail, tail, tail + 1)) == tail)
@@ -64,7 +75,7 @@ public:
     usize next, head = _head;
     for(;; head = next)
     {
-      node = &_queue[head & _capacityMask];
+      node = this->node(head);
       if(Atomic::load(node->head) != head)
         return false;
       if((next = Atomic::compareAndSwap(_head, head, head + 1)) == head)
@@ -84,10 +95,17 @@ private:
     usize head;
   };
 
+  typedef NodeLayout<L, sizeof(Node)> Layout;
+
+private:
+  Node* node(usize index) const {return (Node*)(_queue + Layout::slot(index & _capacityMask, _remapBits) * Layout::stride);}
+
 private:
   usize _capacityMask;
-  Node* _queue;
+  char* _queue;
+  usize _remapBits;
   usize _capacity;
+  void* _buffer;
   char cacheLinePad1[64];
   usize _tail;
   char cacheLinePad2[64];
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "Allocator.h"
+#include "LockFreeQueueCpp11.h"
+
+template <typename T, typename S = size_t, class P = Producers::Multi, class C = Consumers::Multi, class A = HeapAllocator> class LockFreeQueueCompact
+{
+  static_assert(std::is_unsigned<S>::value, "sequence type must be unsigned");
+
+public:
+  explicit LockFreeQueueCompact(size_t capacity, const A& allocator = A()) : _allocator(allocator)
+  {
+    _capacityMask = capacity - 1;
+    for(size_t i = 1; i <= sizeof(void*) * 4; i <<= 1)
+      _capacityMask |= _capacityMask >> i;
+    _capacity = _capacityMask + 1;
+
+    // a full lap and a stale index are only told apart by the sign of the stamp difference, a push to a larger ring would spin when it is full
+    if(_capacity >= (size_t)1 << (sizeof(S) * 8 - 1))
+      throw std::length_error("LockFreeQueueCompact capacity exceeds half the range of the sequence type");
+
+    _queue = (Node*)_allocator.allocate(sizeof(Node) * _capacity);
+    for(size_t i = 0; i < _capacity; ++i)
+      _queue[i].sequence.store((S)i, std::memory_order_relaxed);
+
+    _tail.store(0, std::memory_order_relaxed);
+    _head.store(0, std::memory_order_relaxed);
+  }
+
+  ~LockFreeQueueCompact()
+  {
+    for(size_t i = _head; i != _tail; ++i)
+      (&_queue[i & _capacityMask].data)->~T();
+
+    _allocator.deallocate(_queue, sizeof(Node) * _capacity);
+  }
+
+  size_t capacity() const {return _capacity;}
+
+  size_t size() const
+  {
+    size_t head = _head.load(std::memory_order_acquire);
+    return _tail.load(std::memory_order_relaxed) - head;
+  }
+
+  size_t approx_size() const
+  {
+    size_t head = _head.load(std::memory_order_relaxed);
+    ptrdiff_t size = (ptrdiff_t)(_tail.load(std::memory_order_relaxed) - head);
+    return size <= 0 ? 0 : (size_t)size > _capacity ? _capacity : (size_t)size;
+  }
+
+  bool push(const T& data) {return emplace(data);}
+
+  bool push(T&& data) {return emplace(std::move(data));}
+
+  template <typename... Args> bool emplace(Args&&... args)
+  {
+    Node* node;
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    for(;;)
+    {
+      node = &_queue[tail & _capacityMask];
+      Difference difference = (Difference)(S)(node->sequence.load(std::memory_order_acquire) - (S)tail);
+      if(difference < 0)
+        return false;
+      if(difference > 0)
+        tail = _tail.load(std::memory_order_relaxed);
+      else if(advance<P>(_tail, tail, tail + 1))
+        break;
+    }
+    new (&node->data)T(std::forward<Args>(args)...);
+    node->sequence.store((S)(tail + 1), std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T& result)
+  {
+    Node* node;
+    size_t head = _head.load(std::memory_order_relaxed);
+    for(;;)
+    {
+      node = &_queue[head & _capacityMask];
+      Difference difference = (Difference)(S)(node->sequence.load(std::memory_order_acquire) - (S)(head + 1));
+      if(difference < 0)
+        return false;
+      if(difference > 0)
+        head = _head.load(std::memory_order_relaxed);
+      else if(advance<C>(_head, head, head + 1))
+        break;
+    }
+    result = std::move(node->data);
+    (&node->data)->~T();
+    node->sequence.store((S)(head + _capacity), std::memory_order_release);
+    return true;
+  }
+
+  size_t push_bulk(const T* items, size_t n)
+  {
+    size_t count;
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    for(;;)
+    {
+      for(count = 0; count < n; ++count)
+        if(_queue[(tail + count) & _capacityMask].sequence.load(std::memory_order_acquire) != (S)(tail + count))
+          break;
+      if(!count)
+      {
+        Node* node = &_queue[tail & _capacityMask];
+        if((Difference)(S)(node->sequence.load(std::memory_order_acquire) - (S)tail) < 0)
+          return 0;
+        tail = _tail.load(std::memory_order_relaxed);
+        continue;
+      }
+      if(advance<P>(_tail, tail, tail + count))
+        break;
+    }
+    for(size_t i = 0; i < count; ++i)
+    {
+      Node* node = &_queue[(tail + i) & _capacityMask];
+      new (&node->data)T(items[i]);
+      node->sequence.store((S)(tail + i + 1), std::memory_order_release);
+    }
+    return count;
+  }
+
+  size_t pop_bulk(T* result, size_t max)
+  {
+    size_t count;
+    size_t head = _head.load(std::memory_order_relaxed);
+    for(;;)
+    {
+      for(count = 0; count < max; ++count)
+        if(_queue[(head + count) & _capacityMask].sequence.load(std::memory_order_acquire) != (S)(head + count + 1))
+          break;
+      if(!count)
+      {
+        Node* node = &_queue[head & _capacityMask];
+        if((Difference)(S)(node->sequence.load(std::memory_order_acquire) - (S)(head + 1)) < 0)
+          return 0;
+        head = _head.load(std::memory_order_relaxed);
+        continue;
+      }
+      if(advance<C>(_head, head, head + count))
+        break;
+    }
+    for(size_t i = 0; i < count; ++i)
+    {
+      Node* node = &_queue[(head + i) & _capacityMask];
+      result[i] = std::move(node->data);
+      (&node->data)->~T();
+      node->sequence.store((S)(head + i + _capacity), std::memory_order_release);
+    }
+    return count;
+  }
+
+private:
+  typedef typename std::make_signed<S>::type Difference;
+
+  struct Node
+  {
+    std::atomic<S> sequence;
+    T data;
+  };
+
+private:
+  template <class M> static bool advance(std::atomic<size_t>& index, size_t& value, size_t next)
+  {
+    if(!M::multi)
+    {
+      index.store(next, std::memory_order_relaxed);
+      return true;
+    }
+    return index.compare_exchange_weak(value, next, std::memory_order_relaxed);
+  }
+
+private:
+  size_t _capacityMask;
+  Node* _queue;
+  size_t _capacity;
+  A _allocator;
+  char cacheLinePad1[64];
+  std::atomic<size_t> _tail;
+  char cacheLinePad2[64];
+  std::atomic<size_t> _head;
+  char cacheLinePad3[64];
+};
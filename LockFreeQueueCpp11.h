@@ -2,23 +2,42 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <cstddef>
+#include <utility>
 
-template <typename T> class LockFreeQueueCpp11
+#include "Allocator.h"
+#include "Backoff.h"
+#include "Layout.h"
+
+namespace Producers
+{
+  struct Single {static const bool multi = false;};
+  struct Multi {static const bool multi = true;};
+}
+
+namespace Consumers
+{
+  struct Single {static const bool multi = false;};
+  struct Multi {static const bool multi = true;};
+}
+
+template <typename T, class P = Producers::Multi, class C = Consumers::Multi, class A = HeapAllocator, class L = Layouts::Packed, class B = Backoffs::Yield> class LockFreeQueueCpp11
 {
 public:
-  explicit LockFreeQueueCpp11(size_t capacity)
+  explicit LockFreeQueueCpp11(size_t capacity, const A& allocator = A()) : _allocator(allocator)
   {
     _capacityMask = capacity - 1;
     for(size_t i = 1; i <= sizeof(void*) * 4; i <<= 1)
       _capacityMask |= _capacityMask >> i;
     _capacity = _capacityMask + 1;
 
-    _queue = (Node*)new char[sizeof(Node) * _capacity];
+    _remapBits = Layout::remapBits(_capacity);
+    _queue = (char*)_allocator.allocate(Layout::stride * _capacity);
     for(size_t i = 0; i < _capacity; ++i)
     {
-      _queue[i].tail.store(i, std::memory_order_relaxed);
-      _queue[i].head.store(-1, std::memory_order_relaxed);
+      node(i)->tail.store(i, std::memory_order_relaxed);
+      node(i)->head.store(-1, std::memory_order_relaxed);
     }
 
     _tail.store(0, std::memory_order_relaxed);
@@ -28,9 +47,9 @@ public:
   ~LockFreeQueueCpp11()
   {
     for(size_t i = _head; i != _tail; ++i)
-      (&_queue[i & _capacityMask].data)->~T();
+      (&node(i)->data)->~T();
 
-    delete [] (char*)_queue;
+    _allocator.deallocate(_queue, Layout::stride * _capacity);
   }
   
   size_t capacity() const {return _capacity;}
@@ -40,57 +59,222 @@ public:
     size_t head = _head.load(std::memory_order_acquire);
     return _tail.load(std::memory_order_relaxed) - head;
   }
+
+  // a snapshot for monitoring threads, it never writes to the queue and stays within [0, capacity]
+  size_t approx_size() const
+  {
+    size_t head = _head.load(std::memory_order_relaxed);
+    ptrdiff_t size = (ptrdiff_t)(_tail.load(std::memory_order_relaxed) - head);
+    return size <= 0 ? 0 : (size_t)size > _capacity ? _capacity : (size_t)size;
+  }
   
-  bool push(const T& data)
+  bool push(const T& data) {return emplace(data);}
+
+  bool push(T&& data) {return emplace(std::move(data));}
+
+  template <typename... Args> bool emplace(Args&&... args)
+  {
+    if(!tryEmplace(std::forward<Args>(args)...))
+      return false;
+    _backoff.notify();
+    return true;
+  }
+
+  bool pop(T& result)
+  {
+    if(!tryPop(result))
+      return false;
+    _backoff.notify();
+    return true;
+  }
+
+  // retries a full queue with the backoff policy until the timeout has passed
+  template <class Rep, class Period> bool try_push_for(const T& data, const std::chrono::duration<Rep, Period>& timeout)
+  {
+    return try_push_until(data, std::chrono::steady_clock::now() + timeout);
+  }
+
+  template <class Clock, class Duration> bool try_push_until(const T& data, const std::chrono::time_point<Clock, Duration>& deadline)
+  {
+    return Backoffs::retry(_backoff, [&]() {return tryEmplace(data);}, deadline);
+  }
+
+  template <class Rep, class Period> bool try_pop_for(T& result, const std::chrono::duration<Rep, Period>& timeout)
+  {
+    return try_pop_until(result, std::chrono::steady_clock::now() + timeout);
+  }
+
+  template <class Clock, class Duration> bool try_pop_until(T& result, const std::chrono::time_point<Clock, Duration>& deadline)
+  {
+    return Backoffs::retry(_backoff, [&]() {return tryPop(result);}, deadline);
+  }
+
+  // returns uninitialized storage in the ring, the caller constructs the element in place and passes it to commit
+  T* try_reserve()
+  {
+    Node* node;
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    for(;;)
+    {
+      node = this->node(tail);
+      if(node->tail.load(std::memory_order_acquire) != tail)
+        return 0;
+      if(advance<P>(_tail, tail, tail + 1))
+        break;
+    }
+    return &node->data;
+  }
+
+  void commit(T* data)
+  {
+    // the tail stamp of a reserved node still holds its position
+    Node* node = (Node*)data;
+    node->head.store(node->tail.load(std::memory_order_relaxed), std::memory_order_release);
+    _backoff.notify();
+  }
+
+  // returns the oldest element in its ring slot, it stays valid until it is passed to release
+  const T* try_peek()
+  {
+    Node* node;
+    size_t head = _head.load(std::memory_order_relaxed);
+    for(;;)
+    {
+      node = this->node(head);
+      if(node->head.load(std::memory_order_acquire) != head)
+        return 0;
+      if(advance<C>(_head, head, head + 1))
+        break;
+    }
+    return &node->data;
+  }
+
+  void release(const T* data)
+  {
+    Node* node = (Node*)data;
+    (&node->data)->~T();
+    node->tail.store(node->head.load(std::memory_order_relaxed) + _capacity, std::memory_order_release);
+    _backoff.notify();
+  }
+
+  size_t push_bulk(const T* items, size_t n)
+  {
+    size_t count;
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    for(;;)
+    {
+      for(count = 0; count < n; ++count)
+        if(node(tail + count)->tail.load(std::memory_order_acquire) != tail + count)
+          break;
+      if(!count)
+        return 0;
+      if(advance<P>(_tail, tail, tail + count))
+        break;
+    }
+    for(size_t i = 0; i < count; ++i)
+    {
+      Node* node = this->node(tail + i);
+      new (&node->data)T(items[i]);
+      node->head.store(tail + i, std::memory_order_release);
+    }
+    _backoff.notify();
+    return count;
+  }
+
+  size_t pop_bulk(T* result, size_t max)
+  {
+    size_t count;
+    size_t head = _head.load(std::memory_order_relaxed);
+    for(;;)
+    {
+      for(count = 0; count < max; ++count)
+        if(node(head + count)->head.load(std::memory_order_acquire) != head + count)
+          break;
+      if(!count)
+        return 0;
+      if(advance<C>(_head, head, head + count))
+        break;
+    }
+    for(size_t i = 0; i < count; ++i)
+    {
+      Node* node = this->node(head + i);
+      result[i] = std::move(node->data);
+      (&node->data)->~T();
+      node->tail.store(head + i + _capacity, std::memory_order_release);
+    }
+    _backoff.notify();
+    return count;
+  }
+
+private:
+  struct Node
+  {
+    T data;
+    std::atomic<size_t> tail;
+    std::atomic<size_t> head;
+  };
+
+  typedef NodeLayout<L, sizeof(Node)> Layout;
+
+private:
+  Node* node(size_t index) const {return (Node*)(_queue + Layout::slot(index & _capacityMask, _remapBits) * Layout::stride);}
+
+  // the push and pop without the notification of the backoff policy, for Backoffs::retry
+  template <typename... Args> bool tryEmplace(Args&&... args)
   {
     Node* node;
     size_t tail = _tail.load(std::memory_order_relaxed);
     for(;;)
     {
-      node = &_queue[tail & _capacityMask];
+      node = this->node(tail);
       if(node->tail.load(std::memory_order_relaxed) != tail)
         return false;
-      if((_tail.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed)))
+      if(advance<P>(_tail, tail, tail + 1))
         break;
     }
-    new (&node->data)T(data);
+    new (&node->data)T(std::forward<Args>(args)...);
     node->head.store(tail, std::memory_order_release);
     return true;
   }
 
-  bool pop(T& result)
+  bool tryPop(T& result)
   {
     Node* node;
     size_t head = _head.load(std::memory_order_relaxed);
     for(;;)
     {
-      node = &_queue[head & _capacityMask];
+      node = this->node(head);
       if(node->head.load(std::memory_order_relaxed) != head)
         return false;
-      if(_head.compare_exchange_weak(head, head + 1, std::memory_order_relaxed))
+      if(advance<C>(_head, head, head + 1))
         break;
     }
-    result = node->data;
+    result = std::move(node->data);
     (&node->data)->~T();
     node->tail.store(head + _capacity, std::memory_order_release);
     return true;
   }
 
-private:
-  struct Node
+  template <class M> static bool advance(std::atomic<size_t>& index, size_t& value, size_t next)
   {
-    T data;
-    std::atomic<size_t> tail;
-    std::atomic<size_t> head;
-  };
+    if(!M::multi)
+    {
+      index.store(next, std::memory_order_relaxed);
+      return true;
+    }
+    return index.compare_exchange_weak(value, next, std::memory_order_relaxed);
+  }
 
 private:
   size_t _capacityMask;
-  Node* _queue;
+  char* _queue;
+  size_t _remapBits;
   size_t _capacity;
+  A _allocator;
   char cacheLinePad1[64];
   std::atomic<size_t> _tail;
   char cacheLinePad2[64];
   std::atomic<size_t> _head;
   char cacheLinePad3[64];
+  B _backoff;
 };
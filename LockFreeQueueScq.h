@@ -0,0 +1,200 @@
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+template <typename T> class LockFreeQueueScq
+{
+public:
+  explicit LockFreeQueueScq(size_t capacity)
+  {
+    _capacityMask = capacity - 1;
+    for(size_t i = 1; i <= sizeof(void*) * 4; i <<= 1)
+      _capacityMask |= _capacityMask >> i;
+    _capacity = _capacityMask + 1;
+
+    _queue = (Node*)new char[sizeof(Node) * _capacity];
+    _allocated.init(_capacity, false);
+    _free.init(_capacity, true);
+  }
+
+  ~LockFreeQueueScq()
+  {
+    for(size_t index; (index = _allocated.dequeue()) != Ring::none;)
+      (&_queue[index].data)->~T();
+
+    delete [] (char*)_queue;
+  }
+
+  size_t capacity() const {return _capacity;}
+
+  size_t size() const
+  {
+    size_t size = _allocated.size();
+    return size > _capacity ? _capacity : size;
+  }
+
+  size_t approx_size() const {return size();}
+
+  bool push(const T& data) {return emplace(data);}
+
+  bool push(T&& data) {return emplace(std::move(data));}
+
+  template <typename... Args> bool emplace(Args&&... args)
+  {
+    size_t index = _free.dequeue();
+    if(index == Ring::none)
+      return false;
+    new (&_queue[index].data)T(std::forward<Args>(args)...);
+    _allocated.enqueue(index);
+    return true;
+  }
+
+  bool pop(T& result)
+  {
+    size_t index = _allocated.dequeue();
+    if(index == Ring::none)
+      return false;
+    Node* node = &_queue[index];
+    result = std::move(node->data);
+    (&node->data)->~T();
+    _free.enqueue(index);
+    return true;
+  }
+
+private:
+  struct Node
+  {
+    T data;
+  };
+
+  class Ring
+  {
+  public:
+    static const size_t none = (size_t)-1;
+
+  public:
+    Ring() : _entries(0) {}
+
+    ~Ring() {delete [] _entries;}
+
+    void init(size_t capacity, bool full)
+    {
+      _ringMask = capacity * 2 - 1;
+      _cycleMask = ~(_ringMask * 2 + 1);
+      _safeFlag = _ringMask + 1;
+      _thresholdReset = (ptrdiff_t)(capacity * 3 - 1);
+
+      _entries = new std::atomic<size_t>[_ringMask + 1];
+      for(size_t i = 0; i <= _ringMask; ++i)
+        _entries[i].store(_safeFlag | _ringMask, std::memory_order_relaxed);
+      size_t head = _ringMask + 1, tail = head;
+      if(full)
+        for(size_t i = 0; i < capacity; ++i, ++tail)
+          _entries[tail & _ringMask].store(cycle(tail) | _safeFlag | i, std::memory_order_relaxed);
+
+      _tail.store(tail, std::memory_order_relaxed);
+      _head.store(head, std::memory_order_relaxed);
+      _threshold.store(full ? _thresholdReset : -1, std::memory_order_relaxed);
+    }
+
+    size_t size() const
+    {
+      size_t head = _head.load(std::memory_order_acquire);
+      size_t tail = _tail.load(std::memory_order_relaxed);
+      return (ptrdiff_t)(tail - head) > 0 ? tail - head : 0;
+    }
+
+    void enqueue(size_t index)
+    {
+      for(;;)
+      {
+        size_t tail = _tail.fetch_add(1, std::memory_order_acq_rel);
+        size_t tailCycle = cycle(tail);
+        std::atomic<size_t>& entry = _entries[tail & _ringMask];
+        size_t value = entry.load(std::memory_order_acquire);
+        while((ptrdiff_t)((value & _cycleMask) - tailCycle) < 0 && (value & _ringMask) == _ringMask &&
+          ((value & _safeFlag) || (ptrdiff_t)(_head.load(std::memory_order_acquire) - tail) <= 0))
+        {
+          if(!entry.compare_exchange_weak(value, tailCycle | _safeFlag | index, std::memory_order_acq_rel, std::memory_order_acquire))
+            continue;
+          if(_threshold.load(std::memory_order_relaxed) != _thresholdReset)
+            _threshold.store(_thresholdReset, std::memory_order_relaxed);
+          return;
+        }
+      }
+    }
+
+    size_t dequeue()
+    {
+      if(_threshold.load(std::memory_order_relaxed) < 0)
+        return none;
+      for(;;)
+      {
+        size_t head = _head.fetch_add(1, std::memory_order_acq_rel);
+        size_t headCycle = cycle(head);
+        std::atomic<size_t>& entry = _entries[head & _ringMask];
+        size_t value = entry.load(std::memory_order_acquire);
+        for(;;)
+        {
+          size_t valueCycle = value & _cycleMask;
+          if(valueCycle == headCycle)
+          {
+            entry.fetch_or(_ringMask, std::memory_order_acq_rel);
+            return value & _ringMask;
+          }
+          if((ptrdiff_t)(valueCycle - headCycle) >= 0)
+            break;
+          size_t next = (value & _ringMask) == _ringMask ? headCycle | (value & _safeFlag) | _ringMask : value & ~_safeFlag;
+          if(entry.compare_exchange_weak(value, next, std::memory_order_acq_rel, std::memory_order_acquire))
+            break;
+        }
+        size_t tail = _tail.load(std::memory_order_acquire);
+        if((ptrdiff_t)(tail - (head + 1)) <= 0)
+        {
+          catchup(tail, head + 1);
+          _threshold.fetch_sub(1, std::memory_order_acq_rel);
+          return none;
+        }
+        if(_threshold.fetch_sub(1, std::memory_order_acq_rel) <= 0)
+          return none;
+      }
+    }
+
+  private:
+    std::atomic<size_t>* _entries;
+    size_t _ringMask;
+    size_t _cycleMask;
+    size_t _safeFlag;
+    ptrdiff_t _thresholdReset;
+    char cacheLinePad1[64];
+    std::atomic<size_t> _tail;
+    char cacheLinePad2[64];
+    std::atomic<size_t> _head;
+    char cacheLinePad3[64];
+    std::atomic<ptrdiff_t> _threshold;
+    char cacheLinePad4[64];
+
+  private:
+    size_t cycle(size_t position) const {return (position << 1) & _cycleMask;}
+
+    void catchup(size_t tail, size_t head)
+    {
+      while(!_tail.compare_exchange_weak(tail, head, std::memory_order_acq_rel, std::memory_order_acquire))
+      {
+        head = _head.load(std::memory_order_acquire);
+        if((ptrdiff_t)(tail - head) >= 0)
+          break;
+      }
+    }
+  };
+
+private:
+  size_t _capacityMask;
+  Node* _queue;
+  size_t _capacity;
+  Ring _allocated;
+  Ring _free;
+};
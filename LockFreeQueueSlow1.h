@@ -44,6 +44,8 @@ public:
   usize capacity() const {return _capacity;}
   
   usize size() const {return _capacity - _freeNodes;}
+
+  usize approx_size() const {return size();}
   
   bool push(const T& data)
   {
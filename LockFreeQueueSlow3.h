@@ -37,6 +37,13 @@ public:
     usize head = Atomic::load(_head);
     return _tail - head;
   }
+
+  usize approx_size() const
+  {
+    usize head = Atomic::load(_head);
+    usize size = Atomic::load(_tail) - head;
+    return (ssize)size <= 0 ? 0 : size > _capacity ? _capacity : size;
+  }
   
   bool push(const T& data)
   {
@@ -0,0 +1,135 @@
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+#include "Allocator.h"
+
+template <typename T, class A = HeapAllocator> class LockFreeSpscQueue
+{
+public:
+  explicit LockFreeSpscQueue(size_t capacity, const A& allocator = A()) : _allocator(allocator)
+  {
+    _capacityMask = capacity - 1;
+    for(size_t i = 1; i <= sizeof(void*) * 4; i <<= 1)
+      _capacityMask |= _capacityMask >> i;
+    _capacity = _capacityMask + 1;
+
+    _queue = (Node*)_allocator.allocate(sizeof(Node) * _capacity);
+
+    _tail.store(0, std::memory_order_relaxed);
+    _cachedHead = 0;
+    _head.store(0, std::memory_order_relaxed);
+    _cachedTail = 0;
+  }
+
+  ~LockFreeSpscQueue()
+  {
+    for(size_t i = _head; i != _tail; ++i)
+      (&_queue[i & _capacityMask].data)->~T();
+
+    _allocator.deallocate(_queue, sizeof(Node) * _capacity);
+  }
+
+  size_t capacity() const {return _capacity;}
+
+  size_t size() const
+  {
+    size_t head = _head.load(std::memory_order_acquire);
+    return _tail.load(std::memory_order_relaxed) - head;
+  }
+
+  size_t approx_size() const
+  {
+    size_t head = _head.load(std::memory_order_relaxed);
+    ptrdiff_t size = (ptrdiff_t)(_tail.load(std::memory_order_relaxed) - head);
+    return size <= 0 ? 0 : (size_t)size > _capacity ? _capacity : (size_t)size;
+  }
+
+  bool push(const T& data) {return emplace(data);}
+
+  bool push(T&& data) {return emplace(std::move(data));}
+
+  template <typename... Args> bool emplace(Args&&... args)
+  {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    if(tail - _cachedHead == _capacity)
+    {
+      _cachedHead = _head.load(std::memory_order_acquire);
+      if(tail - _cachedHead == _capacity)
+        return false;
+    }
+    new (&_queue[tail & _capacityMask].data)T(std::forward<Args>(args)...);
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T& result)
+  {
+    size_t head = _head.load(std::memory_order_relaxed);
+    if(head == _cachedTail)
+    {
+      _cachedTail = _tail.load(std::memory_order_acquire);
+      if(head == _cachedTail)
+        return false;
+    }
+    Node* node = &_queue[head & _capacityMask];
+    result = std::move(node->data);
+    (&node->data)->~T();
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t push_bulk(const T* items, size_t n)
+  {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    if(tail - _cachedHead + n > _capacity)
+      _cachedHead = _head.load(std::memory_order_acquire);
+    size_t count = _capacity - (tail - _cachedHead);
+    if(count > n)
+      count = n;
+    for(size_t i = 0; i < count; ++i)
+      new (&_queue[(tail + i) & _capacityMask].data)T(items[i]);
+    _tail.store(tail + count, std::memory_order_release);
+    return count;
+  }
+
+  size_t pop_bulk(T* result, size_t max)
+  {
+    size_t head = _head.load(std::memory_order_relaxed);
+    if(_cachedTail - head < max)
+      _cachedTail = _tail.load(std::memory_order_acquire);
+    size_t count = _cachedTail - head;
+    if(count > max)
+      count = max;
+    for(size_t i = 0; i < count; ++i)
+    {
+      Node* node = &_queue[(head + i) & _capacityMask];
+      result[i] = std::move(node->data);
+      (&node->data)->~T();
+    }
+    _head.store(head + count, std::memory_order_release);
+    return count;
+  }
+
+private:
+  struct Node
+  {
+    T data;
+  };
+
+private:
+  size_t _capacityMask;
+  Node* _queue;
+  size_t _capacity;
+  A _allocator;
+  char cacheLinePad1[64];
+  std::atomic<size_t> _tail;
+  size_t _cachedHead;
+  char cacheLinePad2[64];
+  std::atomic<size_t> _head;
+  size_t _cachedTail;
+  char cacheLinePad3[64];
+};
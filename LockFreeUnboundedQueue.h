@@ -0,0 +1,227 @@
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+#include "HazardPointer.h"
+
+template <typename T> class LockFreeUnboundedQueue
+{
+public:
+  explicit LockFreeUnboundedQueue(size_t segmentCapacity)
+  {
+    _segmentCapacityMask = segmentCapacity - 1;
+    for(size_t i = 1; i <= sizeof(void*) * 4; i <<= 1)
+      _segmentCapacityMask |= _segmentCapacityMask >> i;
+    _segmentCapacity = _segmentCapacityMask + 1;
+
+    Segment* segment = new Segment(_segmentCapacity, 0);
+    _tailSegment.store(segment, std::memory_order_relaxed);
+    _headSegment.store(segment, std::memory_order_relaxed);
+    _pushed.store(0, std::memory_order_relaxed);
+    _popped.store(0, std::memory_order_relaxed);
+  }
+
+  ~LockFreeUnboundedQueue()
+  {
+    for(Segment* segment = _headSegment.load(std::memory_order_relaxed), * next; segment; segment = next)
+    {
+      next = segment->next.load(std::memory_order_relaxed);
+      delete segment;
+    }
+  }
+
+  size_t capacity() const {return (size_t)-1;}
+
+  size_t segmentCapacity() const {return _segmentCapacity;}
+
+  size_t size() const
+  {
+    Segment* headSegment = HazardPointer::protect(_headSegment, 0);
+    Segment* tailSegment = HazardPointer::protect(_tailSegment, 1);
+    size_t head = headSegment->base + headSegment->head.load(std::memory_order_acquire);
+    size_t tail = tailSegment->base + (tailSegment->tail.load(std::memory_order_relaxed) & ~closedFlag);
+    HazardPointer::clear();
+    return (ptrdiff_t)(tail - head) > 0 ? tail - head : 0;
+  }
+
+  // reads the running counters of pushes and pops, size() would have to publish the segments in the hazard pointer slots
+  size_t approx_size() const
+  {
+    size_t popped = _popped.load(std::memory_order_relaxed);
+    ptrdiff_t size = (ptrdiff_t)(_pushed.load(std::memory_order_relaxed) - popped);
+    return size > 0 ? (size_t)size : 0;
+  }
+
+  bool push(const T& data) {return emplace(data);}
+
+  bool push(T&& data) {return emplace(std::move(data));}
+
+  template <typename... Args> bool emplace(Args&&... args)
+  {
+    for(;;)
+    {
+      Segment* segment = HazardPointer::protect(_tailSegment);
+      Segment* next = segment->next.load(std::memory_order_acquire);
+      if(next)
+      {
+        _tailSegment.compare_exchange_strong(segment, next);
+        continue;
+      }
+      if(segment->emplace(std::forward<Args>(args)...))
+      {
+        HazardPointer::clear();
+        _pushed.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+      size_t tail = segment->close();
+      Segment* newSegment = new Segment(_segmentCapacity, segment->base + tail);
+      if(!segment->next.compare_exchange_strong(next, newSegment))
+      {
+        delete newSegment;
+        continue;
+      }
+      _tailSegment.compare_exchange_strong(segment, newSegment);
+    }
+  }
+
+  bool pop(T& result)
+  {
+    for(;;)
+    {
+      Segment* segment = HazardPointer::protect(_headSegment);
+      if(segment->pop(result))
+      {
+        HazardPointer::clear();
+        _popped.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+      Segment* next = segment->next.load(std::memory_order_acquire);
+      if(!next || !segment->drained())
+      {
+        HazardPointer::clear();
+        return false;
+      }
+      Segment* tailSegment = segment;
+      _tailSegment.compare_exchange_strong(tailSegment, next);
+      if(_headSegment.compare_exchange_strong(segment, next))
+      {
+        HazardPointer::clear();
+        HazardPointer::retire(segment);
+      }
+    }
+  }
+
+private:
+  static const size_t closedFlag = (size_t)1 << (sizeof(size_t) * 8 - 1);
+
+  struct Node
+  {
+    T data;
+    std::atomic<size_t> tail;
+    std::atomic<size_t> head;
+  };
+
+  struct Segment
+  {
+    size_t capacityMask;
+    Node* queue;
+    size_t capacity;
+    size_t base;
+    std::atomic<Segment*> next;
+    char cacheLinePad1[64];
+    std::atomic<size_t> tail;
+    char cacheLinePad2[64];
+    std::atomic<size_t> head;
+    char cacheLinePad3[64];
+
+    Segment(size_t capacity, size_t base) : capacityMask(capacity - 1), capacity(capacity), base(base)
+    {
+      queue = (Node*)new char[sizeof(Node) * capacity];
+      for(size_t i = 0; i < capacity; ++i)
+      {
+        queue[i].tail.store(i, std::memory_order_relaxed);
+        queue[i].head.store(-1, std::memory_order_relaxed);
+      }
+      next.store(nullptr, std::memory_order_relaxed);
+      tail.store(0, std::memory_order_relaxed);
+      head.store(0, std::memory_order_relaxed);
+    }
+
+    ~Segment()
+    {
+      for(size_t i = head, end = tail & ~closedFlag; i != end; ++i)
+        (&queue[i & capacityMask].data)->~T();
+
+      delete [] (char*)queue;
+    }
+
+    // fails when the segment is closed or the slot of the previous lap is not released yet, a stale tail is reloaded
+    // the caller then closes the segment, which costs memory, while waiting for a preempted consumer would stall the producers
+    template <typename... Args> bool emplace(Args&&... args)
+    {
+      Node* node;
+      size_t tail = this->tail.load(std::memory_order_relaxed);
+      for(;;)
+      {
+        if(tail & closedFlag)
+          return false;
+        node = &queue[tail & capacityMask];
+        ptrdiff_t lap = (ptrdiff_t)(node->tail.load(std::memory_order_acquire) - tail);
+        if(!lap)
+        {
+          if(this->tail.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed))
+            break;
+          continue;
+        }
+        if(lap < 0)
+          return false;
+        tail = this->tail.load(std::memory_order_relaxed);
+      }
+      new (&node->data)T(std::forward<Args>(args)...);
+      node->head.store(tail, std::memory_order_release);
+      return true;
+    }
+
+    bool pop(T& result)
+    {
+      Node* node;
+      size_t head = this->head.load(std::memory_order_relaxed);
+      for(;;)
+      {
+        node = &queue[head & capacityMask];
+        if(node->head.load(std::memory_order_acquire) != head)
+          return false;
+        if(this->head.compare_exchange_weak(head, head + 1, std::memory_order_relaxed))
+          break;
+      }
+      result = std::move(node->data);
+      (&node->data)->~T();
+      node->tail.store(head + capacity, std::memory_order_release);
+      return true;
+    }
+
+    size_t close() {return tail.fetch_or(closedFlag, std::memory_order_relaxed) & ~closedFlag;}
+
+    bool drained() const
+    {
+      size_t tail = this->tail.load(std::memory_order_acquire);
+      return (tail & closedFlag) && head.load(std::memory_order_relaxed) == (tail & ~closedFlag);
+    }
+  };
+
+private:
+  size_t _segmentCapacityMask;
+  size_t _segmentCapacity;
+  char cacheLinePad1[64];
+  std::atomic<Segment*> _tailSegment;
+  char cacheLinePad2[64];
+  std::atomic<Segment*> _headSegment;
+  char cacheLinePad3[64];
+  std::atomic<size_t> _pushed;
+  char cacheLinePad4[64];
+  std::atomic<size_t> _popped;
+  char cacheLinePad5[64];
+};
@@ -1,6 +1,7 @@
 
 #pragma once
 
+#include <nstd/Atomic.h>
 #include <nstd/Mutex.h>
 #include <nstd/Memory.h>
 
@@ -37,6 +38,14 @@ public:
     _mutex.unlock();
     return result;
   }
+
+  // reads the indices without taking the lock
+  usize approx_size() const
+  {
+    usize head = Atomic::load(_head);
+    usize size = Atomic::load(_tail) - head;
+    return (ssize)size <= 0 ? 0 : size > _capacity ? _capacity : size;
+  }
   
   bool push(const T& data)
   {
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+
+#include "CountedQueue.h"
+#include "LockFreeQueueCpp11.h"
+
+// a push to a full queue evicts the oldest element instead of failing, so producers never wait for the consumers
+template <typename T, class Q = LockFreeQueueCpp11<T> > class OverwriteQueue
+{
+public:
+  explicit OverwriteQueue(size_t capacity) : _queue(capacity) {}
+
+  size_t capacity() const {return _queue.capacity();}
+
+  size_t size() const {return _queue.size();}
+
+  size_t approx_size() const {return _queue.approx_size();}
+
+  // the number of elements evicted by pushes so far
+  size_t drops() const
+  {
+    ptrdiff_t drops = _drops.sum();
+    return drops > 0 ? (size_t)drops : 0;
+  }
+
+  // always succeeds, the evicted elements are the oldest ones at the time of the push
+  bool push(const T& data)
+  {
+    T dropped;
+    while(!_queue.push(data))
+      if(_queue.pop(dropped))
+        _drops.add(1);
+    return true;
+  }
+
+  bool pop(T& result) {return _queue.pop(result);}
+
+private:
+  Q _queue;
+  StripedCounter<> _drops;
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <new>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "LockFreeQueueCpp11.h"
+
+// level 0 is the highest priority, every level is a ring of the given capacity
+template <typename T, size_t Levels, class Q = LockFreeQueueCpp11<T> > class PriorityLockFreeQueue
+{
+  static_assert(Levels > 0 && Levels <= sizeof(size_t) * 8, "one bit of the non-empty mask per level");
+
+public:
+  // with a starvation limit of n, every n-th pop that passes over a non-empty lower level serves one of them instead
+  explicit PriorityLockFreeQueue(size_t capacity, size_t starvationLimit = 0) : _starvationLimit(starvationLimit)
+  {
+    _levels = (Q*)::operator new(sizeof(Q) * Levels);
+    for(size_t i = 0; i < Levels; ++i)
+      new (&_levels[i])Q(capacity);
+
+    _nonEmpty.store(0, std::memory_order_relaxed);
+    _passes.store(0, std::memory_order_relaxed);
+    _agedLevel.store(0, std::memory_order_relaxed);
+  }
+
+  ~PriorityLockFreeQueue()
+  {
+    for(size_t i = 0; i < Levels; ++i)
+      _levels[i].~Q();
+    ::operator delete(_levels);
+  }
+
+  size_t capacity() const {return _levels[0].capacity() * Levels;}
+
+  size_t size() const
+  {
+    size_t size = 0;
+    for(size_t i = 0; i < Levels; ++i)
+      size += _levels[i].size();
+    return size;
+  }
+
+  size_t approx_size() const
+  {
+    size_t size = 0;
+    for(size_t i = 0; i < Levels; ++i)
+      size += _levels[i].approx_size();
+    return size;
+  }
+
+  // a level out of range is a caller bug, release builds reject it like a full ring instead of writing past _levels
+  bool push(const T& data, size_t level)
+  {
+    assert(level < Levels);
+    if(level >= Levels || !_levels[level].push(data))
+      return false;
+    // the bit is only written when it is not set, the fence pairs with the one in pop after a bit is cleared
+    size_t bit = (size_t)1 << level;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(!(_nonEmpty.load(std::memory_order_relaxed) & bit))
+      _nonEmpty.fetch_or(bit, std::memory_order_seq_cst);
+    return true;
+  }
+
+  bool pop(T& result)
+  {
+    size_t level;
+    return pop(result, level);
+  }
+
+  bool pop(T& result, size_t& level)
+  {
+    // every level of the snapshot is tried at most once, a level that turns out to be empty gets its bit cleared
+    for(size_t nonEmpty = _nonEmpty.load(std::memory_order_acquire); nonEmpty;)
+    {
+      level = lowestBit(nonEmpty);
+      size_t lower = nonEmpty & (nonEmpty - 1);
+      if(_starvationLimit && lower && _passes.fetch_add(1, std::memory_order_relaxed) + 1 >= _starvationLimit)
+      {
+        _passes.store(0, std::memory_order_relaxed);
+        level = agedLevel(lower);
+      }
+      if(_levels[level].pop(result))
+        return true;
+
+      size_t bit = (size_t)1 << level;
+      _nonEmpty.fetch_and(~bit, std::memory_order_seq_cst);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if(_levels[level].approx_size())
+        _nonEmpty.fetch_or(bit, std::memory_order_seq_cst);
+      nonEmpty &= ~bit;
+    }
+    return false;
+  }
+
+private:
+  Q* _levels;
+  size_t _starvationLimit;
+  char cacheLinePad1[64];
+  std::atomic<size_t> _nonEmpty;
+  char cacheLinePad2[64];
+  std::atomic<size_t> _passes;
+  std::atomic<size_t> _agedLevel;
+  char cacheLinePad3[64];
+
+private:
+  // picks the lower levels in turn, so that a middle level is not starved by the lowest one
+  size_t agedLevel(size_t lower)
+  {
+    size_t previous = _agedLevel.load(std::memory_order_relaxed);
+    size_t following = previous + 1 < sizeof(size_t) * 8 ? lower & ~(((size_t)1 << (previous + 1)) - 1) : 0;
+    size_t level = lowestBit(following ? following : lower);
+    _agedLevel.store(level, std::memory_order_relaxed);
+    return level;
+  }
+
+  static size_t lowestBit(size_t value)
+  {
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return (size_t)index;
+#elif defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return (size_t)index;
+#else
+    return (size_t)__builtin_ctzll(value);
+#endif
+  }
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+#include "LockFreeQueueCpp11.h"
+
+// spreads the elements over N lanes, each thread pushes to and pops from its home lane first
+// elements are only ordered within a lane, so the elements of one producer stay in order as long as its home lane does not fill up
+template <typename T, class Q = LockFreeQueueCpp11<T>, size_t N = 4> class ShardedQueue
+{
+  static_assert(N > 0, "at least one lane");
+
+public:
+  // the capacity is split evenly over the lanes
+  explicit ShardedQueue(size_t capacity)
+  {
+    size_t laneCapacity = (capacity + N - 1) / N;
+    _lanes = (Q*)::operator new(sizeof(Q) * N);
+    for(size_t i = 0; i < N; ++i)
+      new (&_lanes[i])Q(laneCapacity);
+  }
+
+  ~ShardedQueue()
+  {
+    for(size_t i = 0; i < N; ++i)
+      _lanes[i].~Q();
+    ::operator delete(_lanes);
+  }
+
+  size_t capacity() const {return _lanes[0].capacity() * N;}
+
+  size_t size() const
+  {
+    size_t size = 0;
+    for(size_t i = 0; i < N; ++i)
+      size += _lanes[i].size();
+    return size;
+  }
+
+  size_t approx_size() const
+  {
+    size_t size = 0;
+    for(size_t i = 0; i < N; ++i)
+      size += _lanes[i].approx_size();
+    return size;
+  }
+
+  // a full home lane spills over into the following lanes
+  bool push(const T& data)
+  {
+    size_t home = lane();
+    for(size_t i = 0; i < N; ++i)
+      if(_lanes[(home + i) % N].push(data))
+        return true;
+    return false;
+  }
+
+  // an empty home lane is stolen from the following lanes
+  bool pop(T& result)
+  {
+    size_t home = lane();
+    for(size_t i = 0; i < N; ++i)
+      if(_lanes[(home + i) % N].pop(result))
+        return true;
+    return false;
+  }
+
+private:
+  Q* _lanes;
+
+private:
+  static size_t lane()
+  {
+    static std::atomic<size_t> threads(0);
+    static thread_local size_t lane = threads.fetch_add(1, std::memory_order_relaxed) % N;
+    return lane;
+  }
+};
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+template <typename T> class SharedMemoryQueue
+{
+  static_assert(std::is_trivially_copyable<T>::value, "elements must be trivially copyable to cross process boundaries");
+  static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "shared memory requires address-free 64 bit atomics");
+
+public:
+  static const uint32_t version = 2;
+
+  SharedMemoryQueue() : _header(0), _queue(0), _size(0), _capacityMask(0), _capacity(0) {}
+
+  ~SharedMemoryQueue() {close();}
+
+  // creates and initializes a new segment, and fails if the name is taken by a segment whose creating process is still alive
+  // a segment left behind by a process that has exited is replaced, a live one has to be removed with unlink first
+  bool create(const char* name, size_t capacity)
+  {
+    close();
+
+    uint64_t capacityMask = capacity - 1;
+    for(size_t i = 1; i <= sizeof(uint64_t) * 4; i <<= 1)
+      capacityMask |= capacityMask >> i;
+    uint64_t size = sizeof(Header) + sizeof(Node) * (capacityMask + 1);
+
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if(fd == -1 && errno == EEXIST && isStale(name))
+    {
+      shm_unlink(name);
+      fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    }
+    if(fd == -1)
+      return false;
+    void* data = MAP_FAILED;
+    if(ftruncate(fd, (off_t)size) == 0)
+      data = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(data == MAP_FAILED)
+    {
+      shm_unlink(name);
+      return false;
+    }
+
+    Header* header = (Header*)data;
+    Node* queue = (Node*)(header + 1);
+    header->owner.store((int64_t)getpid(), std::memory_order_relaxed);
+    header->version = version;
+    header->capacity = capacityMask + 1;
+    header->elementSize = sizeof(T);
+    header->nodeSize = sizeof(Node);
+    for(uint64_t i = 0; i <= capacityMask; ++i)
+    {
+      queue[i].tail.store(i, std::memory_order_relaxed);
+      queue[i].head.store(-1, std::memory_order_relaxed);
+    }
+    header->tail.store(0, std::memory_order_relaxed);
+    header->head.store(0, std::memory_order_relaxed);
+
+    // ftruncate zero fills the segment, so attaching processes see no magic until everything above is visible
+    header->magic.store(magic, std::memory_order_release);
+
+    attach(header, (size_t)size);
+    return true;
+  }
+
+  // attaches to a segment created by another process, waiting up to timeout milliseconds for it to be initialized
+  bool open(const char* name, int64_t timeout = 1000)
+  {
+    close();
+    for(int64_t waited = 0;; ++waited)
+    {
+      if(tryOpen(name))
+        return true;
+      if(waited >= timeout)
+        return false;
+      usleep(1000);
+    }
+  }
+
+  void close()
+  {
+    if(!_header)
+      return;
+    munmap(_header, _size);
+    _header = 0;
+    _queue = 0;
+    _size = 0;
+  }
+
+  static bool unlink(const char* name) {return shm_unlink(name) == 0;}
+
+  bool isOpen() const {return _header != 0;}
+
+  size_t capacity() const {return _capacity;}
+
+  size_t size() const
+  {
+    uint64_t head = _header->head.load(std::memory_order_acquire);
+    return (size_t)(_header->tail.load(std::memory_order_relaxed) - head);
+  }
+
+  size_t approx_size() const
+  {
+    uint64_t head = _header->head.load(std::memory_order_relaxed);
+    int64_t size = (int64_t)(_header->tail.load(std::memory_order_relaxed) - head);
+    return size <= 0 ? 0 : (uint64_t)size > _capacity ? (size_t)_capacity : (size_t)size;
+  }
+
+  bool push(const T& data)
+  {
+    Node* node;
+    uint64_t tail = _header->tail.load(std::memory_order_relaxed);
+    for(;;)
+    {
+      node = &_queue[tail & _capacityMask];
+      if(node->tail.load(std::memory_order_relaxed) != tail)
+        return false;
+      if(_header->tail.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed))
+        break;
+    }
+    node->data = data;
+    node->head.store(tail, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T& result)
+  {
+    Node* node;
+    uint64_t head = _header->head.load(std::memory_order_relaxed);
+    for(;;)
+    {
+      node = &_queue[head & _capacityMask];
+      if(node->head.load(std::memory_order_relaxed) != head)
+        return false;
+      if(_header->head.compare_exchange_weak(head, head + 1, std::memory_order_relaxed))
+        break;
+    }
+    result = node->data;
+    node->tail.store(head + _capacity, std::memory_order_release);
+    return true;
+  }
+
+private:
+  static const uint32_t magic = 0x4c465151;
+
+  struct Header
+  {
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    std::atomic<int64_t> owner; // the pid of the creating process
+    uint64_t capacity;
+    uint64_t elementSize;
+    uint64_t nodeSize;
+    char cacheLinePad1[64];
+    std::atomic<uint64_t> tail;
+    char cacheLinePad2[64];
+    std::atomic<uint64_t> head;
+    char cacheLinePad3[64];
+  };
+
+  struct Node
+  {
+    T data;
+    std::atomic<uint64_t> tail;
+    std::atomic<uint64_t> head;
+  };
+
+private:
+  Header* _header;
+  Node* _queue;
+  size_t _size;
+  uint64_t _capacityMask;
+  uint64_t _capacity;
+
+private:
+  void attach(Header* header, size_t size)
+  {
+    _header = header;
+    _queue = (Node*)(header + 1);
+    _size = size;
+    _capacity = header->capacity;
+    _capacityMask = _capacity - 1;
+  }
+
+  // a segment is stale when the process that created it is gone, a segment whose owner is not written yet is still being created
+  static bool isStale(const char* name)
+  {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if(fd == -1)
+      return false;
+    struct stat status;
+    if(fstat(fd, &status) != 0 || (size_t)status.st_size < sizeof(Header))
+    {
+      ::close(fd);
+      return false;
+    }
+    void* data = mmap(NULL, sizeof(Header), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(data == MAP_FAILED)
+      return false;
+    int64_t owner = ((Header*)data)->owner.load(std::memory_order_relaxed);
+    munmap(data, sizeof(Header));
+    return owner > 0 && kill((pid_t)owner, 0) == -1 && errno == ESRCH;
+  }
+
+  // validates the header before touching anything behind it, so a half initialized or foreign segment is rejected instead of faulting
+  bool tryOpen(const char* name)
+  {
+    int fd = shm_open(name, O_RDWR, 0);
+    if(fd == -1)
+      return false;
+    struct stat status;
+    if(fstat(fd, &status) != 0 || (size_t)status.st_size < sizeof(Header))
+    {
+      ::close(fd);
+      return false;
+    }
+    size_t size = (size_t)status.st_size;
+    void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(data == MAP_FAILED)
+      return false;
+    Header* header = (Header*)data;
+    if(header->magic.load(std::memory_order_acquire) != magic || header->version != version ||
+      header->elementSize != sizeof(T) || header->nodeSize != sizeof(Node) ||
+      !header->capacity || (header->capacity & (header->capacity - 1)) || header->capacity > (size - sizeof(Header)) / sizeof(Node))
+    {
+      munmap(data, size);
+      return false;
+    }
+    attach(header, size);
+    return true;
+  }
+};
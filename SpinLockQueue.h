@@ -38,6 +38,14 @@ public:
     Atomic::store(_lock, 0);
     return result;
   }
+
+  // reads the indices without taking the lock
+  usize approx_size() const
+  {
+    usize head = Atomic::load(_head);
+    usize size = Atomic::load(_tail) - head;
+    return (ssize)size <= 0 ? 0 : size > _capacity ? _capacity : size;
+  }
   
   bool push(const T& data)
   {
@@ -1,11 +1,35 @@
 
 #include <nstd/Console.h>
 #include <nstd/Debug.h>
+#include <nstd/File.h>
 #include <nstd/Thread.h>
 #include <nstd/List.h>
+#include <nstd/Process.h>
 #include <nstd/Time.h>
 
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#if __cplusplus >= 201703L
+#include <memory_resource>
+#endif
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
 #include "LockFreeQueueCpp11.h"
+#include "LockFreeQueueCompact.h"
+#include "LockFreeByteQueue.h"
+#include "LockFreeObjectPool.h"
+#include "CountedQueue.h"
+#include "PriorityLockFreeQueue.h"
+#include "WorkStealingDeque.h"
+#include "ShardedQueue.h"
+#include "BroadcastQueue.h"
+#include "OverwriteQueue.h"
+#include "ConflatingQueue.h"
 #include "LockFreeQueue.h"
 #include "LockFreeQueueSlow1.h"
 #include "LockFreeQueueSlow2.h"
@@ -14,17 +38,36 @@
 #include "SpinLockQueue.h"
 #include "mpmc_bounded_queue.h"
 #include "LockFreeLifoQueue.h"
+#include "LockFreeSpscQueue.h"
+#include "LockFreeUnboundedQueue.h"
+#include "LockFreeQueueScq.h"
+#include "BlockingQueue.h"
+#include "LatencyHistogram.h"
+#include "Affinity.h"
+#ifndef _WIN32
+#include "SharedMemoryQueue.h"
+
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#else
+#include <windows.h>
+#endif
 
-static const int testItems = 250000 * 64 / 3 * 10;
-static const int testThreadConsumerThreads = 8;
-static const int testThreadProducerThreads = 8;
-static const int testItemsPerConsumerThread = testItems / testThreadConsumerThreads;
-static const int testItemsPerProducerThread = testItems / testThreadProducerThreads;
+static const int testBulkItems = 16;
+static const int testWakeItems = 500;
+static const int testWakeInterval = 2;
+static const int testPoolThreads = 4;
+static const int testPoolRounds = 20000;
+static const int testSizeItems = 100000;
 
 template<typename T> class IQueue
 {
 public:
   virtual usize size() const = 0;
+  virtual usize approx_size() const = 0;
   virtual usize capacity() const = 0;
   virtual bool push(const T& data) = 0;
   virtual bool pop(T& result) = 0;
@@ -35,6 +78,7 @@ template<typename T, class Q> class TestQueue : public IQueue<T>
 public:
   TestQueue(usize size) : queue(size) {}
   usize size() const {return queue.size();}
+  usize approx_size() const {return queue.approx_size();}
   usize capacity() const {return queue.capacity();}
   bool push(const T& data) {return queue.push(data);}
   bool pop(T& result) {return queue.pop(result);}
@@ -42,71 +86,659 @@ private:
   Q queue;
 };
 
+template<usize N> struct Payload
+{
+  usize value;
+  char data[N - sizeof(usize)];
+
+  Payload() {}
+  Payload(usize value) : value(value) {}
+  operator usize() const {return value;}
+};
+
+static usize allocatedBytes;
+
+class BenchmarkAllocator : public NumaAllocator
+{
+public:
+  explicit BenchmarkAllocator(int node = -1) : NumaAllocator(node) {}
+
+  void* allocate(size_t size)
+  {
+    allocatedBytes += size;
+    return NumaAllocator::allocate(size);
+  }
+};
+
+template<typename T> using LockFreeQueueCpp11MultiMulti = LockFreeQueueCpp11<T, Producers::Multi, Consumers::Multi, BenchmarkAllocator>;
+template<typename T> using LockFreeQueueCpp11MultiSingle = LockFreeQueueCpp11<T, Producers::Multi, Consumers::Single, BenchmarkAllocator>;
+template<typename T> using LockFreeQueueCpp11SingleMulti = LockFreeQueueCpp11<T, Producers::Single, Consumers::Multi, BenchmarkAllocator>;
+template<typename T> using LockFreeQueueCpp11SingleSingle = LockFreeQueueCpp11<T, Producers::Single, Consumers::Single, BenchmarkAllocator>;
+template<typename T> using LockFreeQueueCpp11Padded = LockFreeQueueCpp11<T, Producers::Multi, Consumers::Multi, BenchmarkAllocator, Layouts::Padded>;
+template<typename T> using LockFreeQueueCpp11Remapped = LockFreeQueueCpp11<T, Producers::Multi, Consumers::Multi, BenchmarkAllocator, Layouts::Remapped>;
+template<typename T> using MpmcBoundedQueue = mpmc_bounded_queue<T>;
+template<typename T> using LockFreeQueueCompactSize = LockFreeQueueCompact<T, size_t, Producers::Multi, Consumers::Multi, BenchmarkAllocator>;
+template<typename T> using LockFreeQueueCompact32 = LockFreeQueueCompact<T, uint32_t, Producers::Multi, Consumers::Multi, BenchmarkAllocator>;
+template<typename T> class LockFreeQueueCpp11InPlace
+{
+public:
+  LockFreeQueueCpp11InPlace(usize capacity, const BenchmarkAllocator& allocator) : queue(capacity, allocator) {}
+
+  usize capacity() const {return queue.capacity();}
+  usize size() const {return queue.size();}
+
+  // constructs the element in its ring slot and only reads the value back from there, so a large payload is never copied
+  bool push(const T& item)
+  {
+    T* data = queue.try_reserve();
+    if(!data)
+      return false;
+    new (data) T((usize)item);
+    queue.commit(data);
+    return true;
+  }
+
+  bool pop(T& result)
+  {
+    const T* data = queue.try_peek();
+    if(!data)
+      return false;
+    result = T((usize)*data);
+    queue.release(data);
+    return true;
+  }
+
+private:
+  LockFreeQueueCpp11<T, Producers::Multi, Consumers::Multi, BenchmarkAllocator> queue;
+};
+
+template<typename T> class MallocObjects
+{
+public:
+  explicit MallocObjects(usize) {}
+
+  T* allocate() {return (T*)std::malloc(sizeof(T));}
+  void deallocate(T* data) {std::free(data);}
+};
+
+template<typename T> class PoolObjects
+{
+public:
+  // objects may sit in the magazines of threads that currently do not allocate
+  explicit PoolObjects(usize capacity) : pool(capacity + LockFreeObjectPool<T>::magazineSize * LockFreeObjectPool<T>::magazineCount + 256) {}
+
+  T* allocate() {return pool.allocate();}
+  void deallocate(T* data) {pool.deallocate(data);}
+
+private:
+  LockFreeObjectPool<T> pool;
+};
+
+#if __cplusplus >= 201703L
+template<typename T> class PmrObjects
+{
+public:
+  explicit PmrObjects(usize) {}
+
+  T* allocate() {return (T*)resource.allocate(sizeof(T), alignof(T));}
+  void deallocate(T* data) {resource.deallocate(data, sizeof(T), alignof(T));}
+
+private:
+  std::pmr::synchronized_pool_resource resource;
+};
+#endif
+
+// passes pointers to individually allocated elements through the queue
+template<typename T, class A> class PointerQueue
+{
+public:
+  explicit PointerQueue(usize capacity) : queue(capacity), objects(capacity) {}
+
+  usize capacity() const {return queue.capacity();}
+  usize size() const {return queue.size();}
+
+  bool push(const T& item)
+  {
+    T* data = objects.allocate();
+    if(!data)
+      return false;
+    new (data) T(item);
+    if(queue.push(data))
+      return true;
+    data->~T();
+    objects.deallocate(data);
+    return false;
+  }
+
+  bool pop(T& result)
+  {
+    T* data;
+    if(!queue.pop(data))
+      return false;
+    result = *data;
+    data->~T();
+    objects.deallocate(data);
+    return true;
+  }
+
+private:
+  LockFreeQueueCpp11<T*> queue;
+  A objects;
+};
+
+template<typename T> using MallocPointerQueue = PointerQueue<T, MallocObjects<T> >;
+template<typename T> using PoolPointerQueue = PointerQueue<T, PoolObjects<T> >;
+#if __cplusplus >= 201703L
+template<typename T> using PmrPointerQueue = PointerQueue<T, PmrObjects<T> >;
+#endif
+
+template<typename T> usize priorityLevel(const T& item) {return ((usize)item >> 4) & 3;}
+
+// spreads the elements evenly over four priority levels
+template<typename T, usize S> class PriorityLevels
+{
+public:
+  explicit PriorityLevels(usize capacity) : queue(capacity, S) {}
+
+  usize capacity() const {return queue.capacity();}
+  usize size() const {return queue.size();}
+
+  bool push(const T& item) {return queue.push(item, priorityLevel(item));}
+  bool pop(T& result) {return queue.pop(result);}
+
+private:
+  PriorityLockFreeQueue<T, 4> queue;
+};
+
+// the same levels as separate rings that are probed from the highest priority down
+template<typename T> class ProbingLevels
+{
+public:
+  explicit ProbingLevels(usize capacity)
+  {
+    for(int i = 0; i < 4; ++i)
+      levels[i].reset(new LockFreeQueueCpp11<T>(capacity));
+  }
+
+  usize capacity() const {return levels[0]->capacity() * 4;}
+  usize size() const {return levels[0]->size() + levels[1]->size() + levels[2]->size() + levels[3]->size();}
+
+  bool push(const T& item) {return levels[priorityLevel(item)]->push(item);}
+
+  bool pop(T& result)
+  {
+    for(int i = 0; i < 4; ++i)
+      if(levels[i]->pop(result))
+        return true;
+    return false;
+  }
+
+private:
+  std::unique_ptr<LockFreeQueueCpp11<T> > levels[4];
+};
+
+template<typename T> using PriorityLevelsStrict = PriorityLevels<T, 0>;
+template<typename T> using PriorityLevelsAged = PriorityLevels<T, 16>;
+
+template<typename T> class LockFreeByteQueueRecords
+{
+public:
+  // each element is serialized in place into a record of sizeof(T) bytes, a record may take at most half of the ring
+  LockFreeByteQueueRecords(usize capacity, const BenchmarkAllocator& allocator) : queue((capacity < 2 ? 2 : capacity) * recordSize(), allocator) {}
+
+  usize size() const {return queue.size() / recordSize();}
+
+  bool push(const T& item)
+  {
+    void* data = queue.reserve(sizeof(T));
+    if(!data)
+      return false;
+    new (data) T(item);
+    queue.commit(data);
+    return true;
+  }
+
+  bool pop(T& result)
+  {
+    usize size;
+    const void* data = queue.read(size);
+    if(!data)
+      return false;
+    result = *(const T*)data;
+    queue.release(data);
+    return true;
+  }
+
+private:
+  LockFreeByteQueue<Producers::Multi, Consumers::Multi, BenchmarkAllocator> queue;
+
+private:
+  static usize recordSize() {return (sizeof(T) + LockFreeByteQueue<>::cellSize - 1) / LockFreeByteQueue<>::cellSize * LockFreeByteQueue<>::cellSize;}
+};
+
+template<typename T> using LockFreeQueuePacked = LockFreeQueue<T, Layouts::Packed>;
+template<typename T> using LockFreeQueuePadded = LockFreeQueue<T, Layouts::Padded>;
+template<typename T> using LockFreeQueueRemapped = LockFreeQueue<T, Layouts::Remapped>;
+template<typename T> using LockFreeLifoQueuePlain = LockFreeLifoQueue<T>;
+template<typename T> using LockFreeLifoQueueElimination = LockFreeLifoQueue<T, 8, 64>;
+template<typename T> using LockFreeLifoQueueElimination16 = LockFreeLifoQueue<T, 16, 256>;
+template<typename T> using LockFreeSpscQueueNuma = LockFreeSpscQueue<T, BenchmarkAllocator>;
+template<typename T> using CountedLockFreeQueueCpp11 = CountedQueue<T, LockFreeQueueCpp11<T> >;
+template<typename T> using ShardedQueue1 = ShardedQueue<T, LockFreeQueueCpp11<T>, 1>;
+template<typename T> using ShardedQueue2 = ShardedQueue<T, LockFreeQueueCpp11<T>, 2>;
+template<typename T> using ShardedQueue4 = ShardedQueue<T, LockFreeQueueCpp11<T>, 4>;
+template<typename T> using ShardedQueue8 = ShardedQueue<T, LockFreeQueueCpp11<T>, 8>;
+template<typename T> using ShardedMpmcQueue4 = ShardedQueue<T, mpmc_bounded_queue<T>, 4>;
+template<typename T> using BlockingLockFreeQueueCpp11 = BlockingQueue<T, LockFreeQueueCpp11<T> >;
+template<typename T> using BlockingLockFreeQueue = BlockingQueue<T, LockFreeQueue<T> >;
+
+enum Topology
+{
+  noAffinity,
+  smtAffinity,
+  socketAffinity,
+  crossSocketAffinity,
+  numOfTopologies,
+};
+
+static const tchar* topologyNames[] = {_T("none"), _T("smt"), _T("socket"), _T("cross")};
+
+struct ThreadConfig
+{
+  int producers;
+  int consumers;
+};
+
+struct Options
+{
+  List<ThreadConfig> threads;
+  List<usize> payloads;
+  List<String> queues;
+  List<Topology> topologies;
+  int memoryNode;
+  usize capacity;
+  int64 duration;
+  int warmups;
+  int repeats;
+  bool test;
+  bool wake;
+  bool coldStart;
+  bool scheduler;
+  String csvFile;
+  String jsonFile;
+};
+
+struct Latency
+{
+  double p50;
+  double p99;
+  double p999;
+  double p9999;
+  double max;
+};
+
+struct LatencyHistograms
+{
+  LatencyHistogram push;
+  LatencyHistogram pop;
+  LatencyHistogram endToEnd;
+
+  void merge(const LatencyHistograms& other)
+  {
+    push.merge(other.push);
+    pop.merge(other.pop);
+    endToEnd.merge(other.endToEnd);
+  }
+};
+
+template<class Q> struct BenchmarkContext
+{
+  Q* queue;
+  int cpu;
+  int index; // among the producers or among the consumers
+  LatencyHistograms latency;
+};
+
+struct Result
+{
+  String queue;
+  usize payload;
+  int producers;
+  int consumers;
+  Topology topology;
+  int memoryNode;
+  usize capacity;
+  usize ringBytes;
+  int runs;
+  double meanOpsPerSecond;
+  double stddevOpsPerSecond;
+  double dropRate;
+  double cpuLoad;
+  Latency push;
+  Latency pop;
+  Latency endToEnd;
+};
+
+// the measurements of one run besides its latencies, only some benchmarks drop items or report their cpu time
+struct RunResult
+{
+  double opsPerSecond;
+  double dropRate;
+  double cpuLoad;
+};
+
+static Options options;
+static List<Result> results;
+
 volatile usize producerSum;
 volatile usize consumerSum;
-volatile int64 maxPushDuration;
-volatile int64 maxPopDuration;
+volatile usize producerItems;
+volatile usize consumerItems;
+volatile int32 benchmarkStopped;
+volatile int32 runningProducers;
+
+template<typename T> uint64 elapsedTicks(const T& item, uint64 now)
+{
+  // items only carry the low bits of the push timestamp
+  const uint64 mask = ~(uint64)0 >> (64 - (sizeof(T) < sizeof(usize) ? sizeof(T) : sizeof(usize)) * 8);
+  uint64 elapsed = (now - (uint64)(usize)item) & mask;
+  return elapsed > (mask >> 1) ? 0 : elapsed;
+}
+
+// the cpu time used by all threads of the process so far, std::clock counts wall time on Windows
+static int64 cpuMicroTicks()
+{
+#ifdef _WIN32
+  FILETIME creationTime, exitTime, kernelTime, userTime;
+  if(!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime))
+    return 0;
+  ULARGE_INTEGER kernel, user;
+  kernel.LowPart = kernelTime.dwLowDateTime;
+  kernel.HighPart = kernelTime.dwHighDateTime;
+  user.LowPart = userTime.dwLowDateTime;
+  user.HighPart = userTime.dwHighDateTime;
+  return (int64)((kernel.QuadPart + user.QuadPart) / 10);
+#else
+  struct rusage usage;
+  if(getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+  return ((int64)usage.ru_utime.tv_sec + (int64)usage.ru_stime.tv_sec) * 1000000 + (int64)usage.ru_utime.tv_usec + (int64)usage.ru_stime.tv_usec;
+#endif
+}
 
-uint producerThread(void* param)
+template<class Q, typename T> uint producerThread(void* param)
 {
-  IQueue<int>* queue = (IQueue<int>*)param;
-  for(int i = 0; i < testItemsPerProducerThread; ++i)
+  BenchmarkContext<Q>* context = (BenchmarkContext<Q>*)param;
+  Q* queue = context->queue;
+  usize sum = 0;
+  usize items = 0;
+  while(!Atomic::load(benchmarkStopped))
   {
+    uint64 startTime;
+    T item;
     for(;;)
     {
-      int64 startTime = Time::microTicks();
-      while(!queue->push(i))
-      {
-        Thread::yield();
-        startTime = Time::microTicks();
-      }
-      {
-        int64 duration = Time::microTicks() - startTime;
-        for(;;)
-        {
-          int64 lmaxPushDuration = maxPushDuration;
-          if(duration <= lmaxPushDuration || Atomic::compareAndSwap(maxPushDuration, lmaxPushDuration, duration) == lmaxPushDuration)
-            break;
-        }
+      startTime = CycleClock::now();
+      item = T((usize)startTime);
+      if(queue->push(item))
         break;
-      }
+      Thread::yield();
     }
-    Atomic::fetchAndAdd(producerSum, i);
+    context->latency.push.record(CycleClock::now() - startTime);
+    sum += (usize)item;
+    ++items;
   }
+  Atomic::fetchAndAdd(producerSum, sum);
+  Atomic::fetchAndAdd(producerItems, items);
+  Atomic::decrement(runningProducers);
   return 0;
 }
 
-uint consumerThread(void* param)
+template<class Q, typename T> uint consumerThread(void* param)
 {
-  IQueue<int>* queue = (IQueue<int>*)param;
-  int val;
-  for(int i = 0; i < testItemsPerConsumerThread; ++i)
+  BenchmarkContext<Q>* context = (BenchmarkContext<Q>*)param;
+  Q* queue = context->queue;
+  T val;
+  usize sum = 0;
+  usize items = 0;
+  for(;;)
   {
-    for(;;)
+    uint64 startTime = CycleClock::now();
+    bool popped;
+    while(!(popped = queue->pop(val)) && Atomic::load(runningProducers))
+    {
+      Thread::yield();
+      startTime = CycleClock::now();
+    }
+    if(!popped && !queue->pop(val))
+      break;
+    uint64 now = CycleClock::now();
+    context->latency.pop.record(now - startTime);
+    context->latency.endToEnd.record(elapsedTicks(val, now));
+    sum += (usize)val;
+    ++items;
+  }
+  Atomic::fetchAndAdd(consumerSum, sum);
+  Atomic::fetchAndAdd(consumerItems, items);
+  return 0;
+}
+
+template<class Q, typename T> uint bulkProducerThread(void* param)
+{
+  BenchmarkContext<Q>* context = (BenchmarkContext<Q>*)param;
+  Q* queue = context->queue;
+  T items[testBulkItems];
+  usize sum = 0;
+  usize count = 0;
+  while(!Atomic::load(benchmarkStopped))
+  {
+    for(usize pushed = 0; pushed < testBulkItems;)
     {
-      int64 startTime = Time::microTicks();
-      while(!queue->pop(val))
+      uint64 startTime;
+      usize n;
+      for(;;)
       {
+        startTime = CycleClock::now();
+        for(usize j = pushed; j < testBulkItems; ++j)
+          items[j] = T((usize)startTime);
+        if((n = queue->push_bulk(items + pushed, testBulkItems - pushed)))
+          break;
         Thread::yield();
-        startTime = Time::microTicks();
-      }
-      {
-        int64 duration = Time::microTicks() - startTime;
-        for(;;)
-        {
-          int64 lmaxPopDuration = maxPopDuration;
-          if(duration <= lmaxPopDuration || Atomic::compareAndSwap(maxPopDuration, lmaxPopDuration, duration) == lmaxPopDuration)
-            break;
-        }
-        break;
       }
+      context->latency.push.record(CycleClock::now() - startTime);
+      for(usize j = pushed; j < pushed + n; ++j)
+        sum += (usize)items[j];
+      pushed += n;
+    }
+    count += testBulkItems;
+  }
+  Atomic::fetchAndAdd(producerSum, sum);
+  Atomic::fetchAndAdd(producerItems, count);
+  Atomic::decrement(runningProducers);
+  return 0;
+}
+
+template<class Q, typename T> uint bulkConsumerThread(void* param)
+{
+  BenchmarkContext<Q>* context = (BenchmarkContext<Q>*)param;
+  Q* queue = context->queue;
+  T items[testBulkItems];
+  usize sum = 0;
+  usize count = 0;
+  for(;;)
+  {
+    uint64 startTime = CycleClock::now();
+    usize n;
+    while(!(n = queue->pop_bulk(items, testBulkItems)) && Atomic::load(runningProducers))
+    {
+      Thread::yield();
+      startTime = CycleClock::now();
+    }
+    if(!n && !(n = queue->pop_bulk(items, testBulkItems)))
+      break;
+    uint64 now = CycleClock::now();
+    context->latency.pop.record(now - startTime);
+    for(usize j = 0; j < n; ++j)
+    {
+      context->latency.endToEnd.record(elapsedTicks(items[j], now));
+      sum += (usize)items[j];
     }
-    Atomic::fetchAndAdd(consumerSum, val);
+    count += n;
+  }
+  Atomic::fetchAndAdd(consumerSum, sum);
+  Atomic::fetchAndAdd(consumerItems, count);
+  return 0;
+}
+
+template<class Q> static void pinThread(void* param)
+{
+  int cpu = ((BenchmarkContext<Q>*)param)->cpu;
+  if(cpu >= 0 && !Affinity::pin(cpu))
+    Console::errorf(_T("Could not pin thread to cpu %d.\n"), cpu);
+}
+
+int64 totalWakeLatency;
+int64 maxWakeLatency;
+
+template<class Q> uint wakeProducerThread(void* param)
+{
+  Q* queue = (Q*)param;
+  for(int i = 0; i < testWakeItems; ++i)
+  {
+    Thread::sleep(testWakeInterval);
+    while(!queue->push(Time::microTicks()))
+      Thread::yield();
+  }
+  return 0;
+}
+
+template<class Q> uint yieldWakeConsumerThread(void* param)
+{
+  Q* queue = (Q*)param;
+  int64 timestamp;
+  for(int i = 0; i < testWakeItems; ++i)
+  {
+    while(!queue->pop(timestamp))
+      Thread::yield();
+    int64 latency = Time::microTicks() - timestamp;
+    totalWakeLatency += latency;
+    if(latency > maxWakeLatency)
+      maxWakeLatency = latency;
+  }
+  return 0;
+}
+
+template<class Q> uint blockingWakeConsumerThread(void* param)
+{
+  Q* queue = (Q*)param;
+  int64 timestamp;
+  for(int i = 0; i < testWakeItems; ++i)
+  {
+    queue->pop_wait(timestamp);
+    int64 latency = Time::microTicks() - timestamp;
+    totalWakeLatency += latency;
+    if(latency > maxWakeLatency)
+      maxWakeLatency = latency;
   }
   return 0;
 }
 
-template<class Q> void testQueue(const String& name, bool fifo = false)
+template<class Q> void testWakeLatency(const String& name, uint (*consumerThread)(void*))
+{
+  Console::printf(_T("Testing %s wake latency... \n"), (const tchar*)name);
+
+  totalWakeLatency = 0;
+  maxWakeLatency = 0;
+
+  int64 cpuStartTime = cpuMicroTicks();
+  int64 microStartTime = Time::microTicks();
+  {
+    Q queue(100);
+    Thread producer, consumer;
+    consumer.start(consumerThread, &queue);
+    producer.start(wakeProducerThread<Q>, &queue);
+    producer.join();
+    consumer.join();
+    ASSERT(queue.size() == 0);
+  }
+  int64 microDuration = Time::microTicks() - microStartTime;
+  int64 cpuDuration = (cpuMicroTicks() - cpuStartTime) / 1000;
+  Console::printf(_T("%lld ms, cpu: %lld ms, avgWake: %lld microseconds, maxWake: %lld microseconds\n"), microDuration / 1000, cpuDuration, totalWakeLatency / testWakeItems, maxWakeLatency);
+}
+
+template<class Q> void testBlockingQueue(const String& name)
+{
+  Console::printf(_T("Testing %s... \n"), (const tchar*)name);
+
+  Q queue(2);
+  int result;
+  int64 startTime = Time::ticks();
+  ASSERT(!queue.pop_wait(result, 20));
+  ASSERT(Time::ticks() - startTime >= 20);
+  ASSERT(queue.push_wait(42, 0));
+  ASSERT(queue.push_wait(43, 0));
+  startTime = Time::ticks();
+  ASSERT(!queue.push_wait(44, 20));
+  ASSERT(Time::ticks() - startTime >= 20);
+  queue.pop_wait(result);
+  ASSERT(result == 42);
+  ASSERT(queue.pop_wait(result, 0));
+  ASSERT(result == 43);
+}
+
+template<class Q, class S> void testMoveOnlyQueue(const String& name)
+{
+  Console::printf(_T("Testing %s with move-only elements... \n"), (const tchar*)name);
+
+  {
+    Q queue(2);
+    std::unique_ptr<int> result;
+    std::unique_ptr<int> item(new int(42));
+    ASSERT(queue.push(std::move(item)));
+    ASSERT(!item);
+    ASSERT(queue.emplace(new int(43)));
+    item.reset(new int(44));
+    ASSERT(!queue.push(std::move(item)));
+    ASSERT(item && *item == 44);
+    ASSERT(queue.pop(result));
+    ASSERT(result && *result == 42);
+    ASSERT(queue.pop(result));
+    ASSERT(result && *result == 43);
+    ASSERT(!queue.pop(result));
+    ASSERT(queue.push(std::move(item)));
+  }
+
+  {
+    S queue(2);
+    std::string result;
+    ASSERT(queue.emplace(64, 'x'));
+    ASSERT(queue.pop(result));
+    ASSERT(result == std::string(64, 'x'));
+  }
+}
+
+template<class Q> void testUnboundedQueue(const String& name)
+{
+  Console::printf(_T("Testing %s bursts... \n"), (const tchar*)name);
+
+  Q queue(16);
+  int result;
+  for(int i = 0; i < 3; ++i)
+  {
+    for(int j = 0; j < 1000; ++j)
+      ASSERT(queue.push(j));
+    ASSERT(queue.size() == 1000);
+    for(int j = 0; j < 1000; ++j)
+    {
+      ASSERT(queue.pop(result));
+      ASSERT(result == j);
+    }
+    ASSERT(!queue.pop(result));
+    ASSERT(queue.size() == 0);
+  }
+}
+
+template<class Q> void testQueue(const String& name, bool lifo = false)
 {
   Console::printf(_T("Testing %s... \n"), (const tchar*)name);
 
@@ -130,9 +762,13 @@ template<class Q> void testQueue(const String& name, bool fifo = false)
     ASSERT(queue.capacity() >= 10000);
     ASSERT(!queue.pop(result));
     ASSERT(queue.push(42));
+    ASSERT(queue.size() == 1);
+    ASSERT(queue.approx_size() == 1);
     ASSERT(queue.pop(result));
     ASSERT(result == 42);
     ASSERT(!queue.pop(result));
+    ASSERT(queue.size() == 0);
+    ASSERT(queue.approx_size() == 0);
   }
 
   {
@@ -142,67 +778,2379 @@ template<class Q> void testQueue(const String& name, bool fifo = false)
     ASSERT(!queue.pop(result));
     ASSERT(queue.push(42));
     ASSERT(queue.push(43));
+    ASSERT(queue.size() == 2);
+    ASSERT(queue.approx_size() == 2);
     ASSERT(queue.pop(result));
-    ASSERT(result == (fifo ? 43 : 42));
+    ASSERT(result == (lifo ? 43 : 42));
     ASSERT(queue.pop(result));
-    ASSERT(result == (fifo ? 42 : 43));
+    ASSERT(result == (lifo ? 42 : 43));
     ASSERT(!queue.pop(result));
     ASSERT(queue.push(44));
     ASSERT(queue.push(45));
     ASSERT(queue.pop(result));
-    ASSERT(result == (fifo ? 45 : 44));
+    ASSERT(result == (lifo ? 45 : 44));
     ASSERT(queue.push(47));
   }
+}
 
-  producerSum = 0;
-  consumerSum = 0;
-  maxPushDuration = 0;
-  maxPopDuration = 0;
+static const int testPriorityItems = 100000;
+static const int testPriorityLevels = 4;
 
-  int64 microStartTime = Time::microTicks();
+template<class Q> struct PriorityContext
+{
+  Q* queue;
+  int producer;
+  volatile bool done;
+  std::vector<char> popped;
+};
+
+// pushes its items round robin to the levels, an item is on the level of its remainder
+template<class Q> uint priorityProducerThread(void* param)
+{
+  PriorityContext<Q>* context = (PriorityContext<Q>*)param;
+  for(int i = 0; i < testPriorityItems; ++i)
   {
-    TestQueue<int, Q> queue(100);
-    List<Thread*> threads;
-    for(int i = 0; i < testThreadProducerThreads; ++i)
-    {
-      Thread* thread = new Thread;
-      thread->start(producerThread, &queue);
-      threads.append(thread);
-    }
-    for(int i = 0; i < testThreadConsumerThreads; ++i)
+    int item = context->producer * testPriorityItems + i;
+    while(!context->queue->push(item, (usize)(i % testPriorityLevels)))
+      Thread::yield();
+  }
+  return 0;
+}
+
+template<class Q> uint priorityConsumerThread(void* param)
+{
+  PriorityContext<Q>* context = (PriorityContext<Q>*)param;
+  int result;
+  usize level;
+  for(;;)
+  {
+    // a pop that fails after the producers were done means that all levels are empty
+    bool done = context->done;
+    if(context->queue->pop(result, level))
     {
-      Thread* thread = new Thread;
-      thread->start(consumerThread, &queue);
-      threads.append(thread);
+      ASSERT((usize)(result % testPriorityLevels) == level);
+      ASSERT(!context->popped[result]);
+      context->popped[result] = 1;
     }
-    for(List<Thread*>::Iterator i = threads.begin(), end = threads.end(); i != end; ++i)
+    else if(done)
+      return 0;
+    else
+      Thread::yield();
+  }
+}
+
+template<class Q> void testPriorityQueue(const String& name)
+{
+  Console::printf(_T("Testing %s... \n"), (const tchar*)name);
+
+  {
+    Q queue(4);
+    int result;
+    usize level;
+    ASSERT(!queue.pop(result));
+    ASSERT(queue.push(30, 3));
+    ASSERT(queue.push(10, 1));
+    ASSERT(queue.push(11, 1));
+    ASSERT(queue.push(0, 0));
+    ASSERT(queue.size() == 4);
+    ASSERT(queue.pop(result, level) && result == 0 && level == 0);
+    ASSERT(queue.pop(result, level) && result == 10 && level == 1);
+    ASSERT(queue.push(1, 0));
+    ASSERT(queue.pop(result, level) && result == 1 && level == 0);
+    ASSERT(queue.pop(result, level) && result == 11 && level == 1);
+    ASSERT(queue.pop(result, level) && result == 30 && level == 3);
+    ASSERT(!queue.pop(result));
+    ASSERT(queue.approx_size() == 0);
+  }
+
+  {
+    // every third pop serves the lower levels in turn while level 0 stays busy
+    Q queue(16, 3);
+    int result;
+    usize level;
+    for(int i = 0; i < 8; ++i)
+    {
+      ASSERT(queue.push(i, 0));
+      ASSERT(queue.push(100 + i, 1));
+      ASSERT(queue.push(200 + i, 2));
+    }
+    usize levels[6];
+    for(int i = 0; i < 6; ++i)
+    {
+      ASSERT(queue.pop(result, level));
+      levels[i] = level;
+    }
+    ASSERT(levels[0] == 0 && levels[1] == 0 && levels[2] == 1);
+    ASSERT(levels[3] == 0 && levels[4] == 0 && levels[5] == 2);
+  }
+
+  // 2 producers and 2 consumers on small rings, with and without a starvation limit
+  for(usize starvationLimit = 0; starvationLimit <= 3; starvationLimit += 3)
+  {
+    Q queue(64, starvationLimit);
+    PriorityContext<Q> producers[2], consumers[2];
+    Thread producerThreads[2], consumerThreads[2];
+    for(int i = 0; i < 2; ++i)
+    {
+      consumers[i].queue = &queue;
+      consumers[i].done = false;
+      consumers[i].popped.assign(testPriorityItems * 2, 0);
+      consumerThreads[i].start(priorityConsumerThread<Q>, &consumers[i]);
+    }
+    for(int i = 0; i < 2; ++i)
+    {
+      producers[i].queue = &queue;
+      producers[i].producer = i;
+      producerThreads[i].start(priorityProducerThread<Q>, &producers[i]);
+    }
+    for(int i = 0; i < 2; ++i)
+      producerThreads[i].join();
+    for(int i = 0; i < 2; ++i)
+      consumers[i].done = true;
+    for(int i = 0; i < 2; ++i)
+      consumerThreads[i].join();
+    for(int i = 0; i < testPriorityItems * 2; ++i)
+      ASSERT(consumers[0].popped[i] + consumers[1].popped[i] == 1);
+    ASSERT(queue.size() == 0);
+  }
+}
+
+template<class Q> uint sizeProducerThread(void* param)
+{
+  Q* queue = (Q*)param;
+  for(int i = 0; i < testSizeItems; ++i)
+    while(!queue->push(i))
+      Thread::yield();
+  return 0;
+}
+
+template<class Q> uint sizeConsumerThread(void* param)
+{
+  Q* queue = (Q*)param;
+  int result;
+  for(int i = 0; i < testSizeItems;)
+    if(queue->pop(result))
+      ++i;
+    else
+      Thread::yield();
+  return 0;
+}
+
+template<class Q> void testSizeUnderLoad(const String& name)
+{
+  Console::printf(_T("Testing %s approx_size under load... \n"), (const tchar*)name);
+
+  Q queue(64);
+  Thread threads[4];
+  threads[0].start(sizeProducerThread<Q>, &queue);
+  threads[1].start(sizeProducerThread<Q>, &queue);
+  threads[2].start(sizeConsumerThread<Q>, &queue);
+  threads[3].start(sizeConsumerThread<Q>, &queue);
+  for(int i = 0; i < 1000; ++i)
+  {
+    ASSERT(queue.approx_size() <= queue.capacity());
+    Thread::yield();
+  }
+  for(int i = 0; i < 4; ++i)
+    threads[i].join();
+  ASSERT(queue.size() == 0);
+  ASSERT(queue.approx_size() == 0);
+}
+
+static const int testBroadcastItems = 100000;
+
+template<class Q> struct BroadcastTestContext
+{
+  Q* queue;
+  usize consumer;
+  usize items;
+  usize sum;
+};
+
+template<class Q> uint broadcastTestProducerThread(void* param)
+{
+  Q* queue = ((BroadcastTestContext<Q>*)param)->queue;
+  for(int i = 1; i <= testBroadcastItems;)
+    if(queue->push(i))
+      ++i;
+    else
+      Thread::yield();
+  return 0;
+}
+
+template<class Q> uint broadcastTestConsumerThread(void* param)
+{
+  BroadcastTestContext<Q>* context = (BroadcastTestContext<Q>*)param;
+  int items[testBulkItems];
+  while(context->items < (usize)testBroadcastItems * 2)
+  {
+    usize n = context->queue->pop_bulk(context->consumer, items, testBulkItems);
+    if(!n)
+      Thread::yield();
+    for(usize i = 0; i < n; ++i)
+      context->sum += items[i];
+    context->items += n;
+  }
+  return 0;
+}
+
+template<class Q> void testBroadcastQueue(const String& name)
+{
+  Console::printf(_T("Testing %s... \n"), (const tchar*)name);
+
+  {
+    Q queue(3, 2);
+    int result;
+    int items[4];
+    ASSERT(queue.capacity() == 4);
+    ASSERT(queue.consumers() == 2);
+    ASSERT(!queue.pop(0, result));
+    for(int i = 0; i < 4; ++i)
+      ASSERT(queue.push(42 + i));
+    ASSERT(!queue.push(46));
+    ASSERT(queue.size() == 4);
+    ASSERT(queue.pop_bulk(0, items, 4) == 4);
+    ASSERT(items[0] == 42 && items[1] == 43 && items[2] == 44 && items[3] == 45);
+    ASSERT(!queue.pop(0, result));
+    // the second consumer still gates the producer
+    ASSERT(!queue.push(46));
+    ASSERT(queue.size() == 4);
+    ASSERT(queue.pop(1, result));
+    ASSERT(result == 42);
+    ASSERT(queue.push(46));
+    ASSERT(!queue.push(47));
+    ASSERT(queue.pop_bulk(1, items, 4) == 4);
+    ASSERT(items[0] == 43 && items[3] == 46);
+    ASSERT(queue.size() == 1);
+    ASSERT(queue.pop(0, result));
+    ASSERT(result == 46);
+    ASSERT(queue.size() == 0);
+    ASSERT(queue.approx_size() == 0);
+  }
+
+  {
+    // two producers and three consumers, every consumer has to see every item once
+    Q queue(64, 3);
+    BroadcastTestContext<Q> contexts[5];
+    Thread threads[5];
+    for(int i = 0; i < 5; ++i)
+    {
+      contexts[i].queue = &queue;
+      contexts[i].consumer = i;
+      contexts[i].items = 0;
+      contexts[i].sum = 0;
+      threads[i].start(i < 3 ? broadcastTestConsumerThread<Q> : broadcastTestProducerThread<Q>, &contexts[i]);
+    }
+    for(int i = 0; i < 5; ++i)
+      threads[i].join();
+    for(int i = 0; i < 3; ++i)
+    {
+      ASSERT(contexts[i].items == (usize)testBroadcastItems * 2);
+      ASSERT(contexts[i].sum == (usize)testBroadcastItems * (testBroadcastItems + 1));
+    }
+    ASSERT(queue.size() == 0);
+  }
+}
+
+static const int testOverwriteItems = 100000;
+
+template<class Q> uint overwriteProducerThread(void* param)
+{
+  Q* queue = (Q*)param;
+  for(int i = 0; i < testOverwriteItems; ++i)
+    ASSERT(queue->push(i));
+  return 0;
+}
+
+template<class Q> void testOverwriteQueue(const String& name)
+{
+  Console::printf(_T("Testing %s... \n"), (const tchar*)name);
+
+  {
+    Q queue(4);
+    int result;
+    for(int i = 0; i < 10; ++i)
+      ASSERT(queue.push(i));
+    ASSERT(queue.size() == 4);
+    ASSERT(queue.drops() == 6);
+    for(int i = 6; i < 10; ++i)
+    {
+      ASSERT(queue.pop(result));
+      ASSERT(result == i);
+    }
+    ASSERT(!queue.pop(result));
+  }
+
+  {
+    // every item is either popped or counted as dropped
+    Q queue(16);
+    Thread threads[2];
+    for(int i = 0; i < 2; ++i)
+      threads[i].start(overwriteProducerThread<Q>, &queue);
+    usize items = 0;
+    int result;
+    for(int i = 0; i < testOverwriteItems; ++i)
+      if(queue.pop(result))
+        ++items;
+    for(int i = 0; i < 2; ++i)
+      threads[i].join();
+    while(queue.pop(result))
+      ++items;
+    ASSERT(items + queue.drops() == (usize)testOverwriteItems * 2);
+  }
+}
+
+template<class Q> uint conflatingProducerThread(void* param)
+{
+  Q* queue = (Q*)param;
+  for(int i = 0; i < testOverwriteItems; ++i)
+    ASSERT(queue->push(i % queue->keys(), i));
+  return 0;
+}
+
+template<class Q> struct ConflatingConsumerContext
+{
+  Q* queue;
+  volatile bool done;
+  usize items;
+  std::vector<int> latest;
+};
+
+template<class Q> uint conflatingConsumerThread(void* param)
+{
+  ConflatingConsumerContext<Q>* context = (ConflatingConsumerContext<Q>*)param;
+  usize key;
+  int result;
+  for(;;)
+    if(context->queue->pop(key, result))
+    {
+      ASSERT((usize)result % context->queue->keys() == key);
+      if(result > context->latest[key])
+        context->latest[key] = result;
+      ++context->items;
+    }
+    else if(context->done)
+      return 0;
+    else
+      Thread::yield();
+}
+
+template<class Q> void testConflatingQueue(const String& name)
+{
+  Console::printf(_T("Testing %s... \n"), (const tchar*)name);
+
+  {
+    Q queue(4);
+    usize key;
+    int result;
+    ASSERT(!queue.pop(key, result));
+    ASSERT(queue.push(1, 10));
+    ASSERT(queue.push(2, 20));
+    ASSERT(queue.push(1, 11));
+    ASSERT(queue.size() == 2);
+    ASSERT(queue.drops() == 1);
+    ASSERT(queue.pop(key, result));
+    ASSERT(key == 1 && result == 11);
+    ASSERT(queue.push(1, 12));
+    ASSERT(queue.pop(key, result));
+    ASSERT(key == 2 && result == 20);
+    ASSERT(queue.pop(key, result));
+    ASSERT(key == 1 && result == 12);
+    ASSERT(!queue.pop(key, result));
+    ASSERT(queue.drops() == 1);
+  }
+
+  {
+    // the values of a key only grow, and the latest value of every key is delivered
+    Q queue(7);
+    Thread thread;
+    thread.start(conflatingProducerThread<Q>, &queue);
+    std::vector<int> latest(queue.keys(), -1);
+    usize items = 0;
+    usize key;
+    int result;
+    for(int i = 0; i < testOverwriteItems; ++i)
+      if(queue.pop(key, result))
+      {
+        ASSERT(result > latest[key]);
+        ASSERT((usize)result % queue.keys() == key);
+        latest[key] = result;
+        ++items;
+      }
+    thread.join();
+    while(queue.pop(key, result))
+    {
+      ASSERT(result > latest[key]);
+      latest[key] = result;
+      ++items;
+    }
+    for(usize i = 0; i < queue.keys(); ++i)
+      ASSERT(latest[i] == testOverwriteItems - 1 - (int)((testOverwriteItems - 1 - i) % queue.keys()));
+    ASSERT(items + queue.drops() == (usize)testOverwriteItems);
+  }
+
+  {
+    // with several consumers a key is pushed again while another consumer still holds the slot it was popped from
+    Q queue(4);
+    ConflatingConsumerContext<Q> contexts[3];
+    Thread threads[3];
+    for(int i = 0; i < 3; ++i)
+    {
+      contexts[i].queue = &queue;
+      contexts[i].done = false;
+      contexts[i].items = 0;
+      contexts[i].latest.assign(queue.keys(), -1);
+      threads[i].start(conflatingConsumerThread<Q>, &contexts[i]);
+    }
+    Thread producer;
+    producer.start(conflatingProducerThread<Q>, &queue);
+    producer.join();
+    usize items = 0;
+    std::vector<int> latest(queue.keys(), -1);
+    for(int i = 0; i < 3; ++i)
+    {
+      contexts[i].done = true;
+      threads[i].join();
+      items += contexts[i].items;
+      for(usize j = 0; j < queue.keys(); ++j)
+        if(contexts[i].latest[j] > latest[j])
+          latest[j] = contexts[i].latest[j];
+    }
+    for(usize i = 0; i < queue.keys(); ++i)
+      ASSERT(latest[i] == testOverwriteItems - 1 - (int)((testOverwriteItems - 1 - i) % queue.keys()));
+    ASSERT(items + queue.drops() == (usize)testOverwriteItems);
+    ASSERT(queue.size() == 0);
+  }
+}
+
+template<class Q> uint timedPopThread(void* param)
+{
+  Q* queue = (Q*)param;
+  Thread::sleep(20);
+  int result;
+  ASSERT(queue->pop(result));
+  return 0;
+}
+
+template<class Q> uint timedPushThread(void* param)
+{
+  Q* queue = (Q*)param;
+  Thread::sleep(20);
+  ASSERT(queue->push(44));
+  return 0;
+}
+
+template<class Q> void testTimedQueue(const String& name)
+{
+  Console::printf(_T("Testing %s timed push and pop... \n"), (const tchar*)name);
+
+  Q queue(2);
+  int result;
+  int64 startTime = Time::ticks();
+  ASSERT(!queue.try_pop_for(result, std::chrono::milliseconds(10)));
+  ASSERT(Time::ticks() - startTime >= 10);
+  ASSERT(queue.try_push_for(42, std::chrono::milliseconds(10)));
+  ASSERT(queue.try_push_until(43, std::chrono::steady_clock::now() - std::chrono::seconds(1)));
+  startTime = Time::ticks();
+  ASSERT(!queue.try_push_until(44, std::chrono::steady_clock::now() + std::chrono::milliseconds(10)));
+  ASSERT(Time::ticks() - startTime >= 10);
+
+  // a waiting push and pop are served by the other side within the timeout
+  Thread thread;
+  thread.start(timedPopThread<Q>, &queue);
+  ASSERT(queue.try_push_for(44, std::chrono::seconds(10)));
+  thread.join();
+  ASSERT(queue.try_pop_until(result, std::chrono::system_clock::now()));
+  ASSERT(result == 43);
+  ASSERT(queue.try_pop_for(result, std::chrono::milliseconds(0)));
+  ASSERT(result == 44);
+  thread.start(timedPushThread<Q>, &queue);
+  ASSERT(queue.try_pop_for(result, std::chrono::seconds(10)));
+  ASSERT(result == 44);
+  thread.join();
+  ASSERT(queue.size() == 0);
+}
+
+template<class Q> void testShardedQueue(const String& name)
+{
+  Console::printf(_T("Testing %s lanes... \n"), (const tchar*)name);
+
+  // a single thread fills its home lane first and then spills over, so its elements come back in order
+  Q queue(64);
+  int result;
+  ASSERT(queue.capacity() == 64);
+  for(int i = 0; i < 2; ++i)
+  {
+    for(int j = 0; j < 64; ++j)
+      ASSERT(queue.push(j));
+    ASSERT(!queue.push(64));
+    ASSERT(queue.size() == 64);
+    for(int j = 0; j < 64; ++j)
+    {
+      ASSERT(queue.pop(result));
+      ASSERT(result == j);
+    }
+    ASSERT(!queue.pop(result));
+    ASSERT(queue.approx_size() == 0);
+  }
+}
+
+static const int testStealItems = 100000;
+
+template<class Q> struct StealContext
+{
+  Q* deque;
+  volatile bool done;
+  usize items;
+  usize sum;
+};
+
+template<class Q> uint thiefThread(void* param)
+{
+  StealContext<Q>* context = (StealContext<Q>*)param;
+  int result;
+  for(;;)
+    if(context->deque->steal(result))
+    {
+      ++context->items;
+      context->sum += result;
+    }
+    else if(context->done)
+      return 0;
+    else
+      Thread::yield();
+}
+
+template<class Q> void testWorkStealingDeque(const String& name)
+{
+  Console::printf(_T("Testing %s... \n"), (const tchar*)name);
+
+  {
+    Q deque(3);
+    int result;
+    ASSERT(deque.capacity() == 4);
+    ASSERT(!deque.pop(result));
+    ASSERT(!deque.steal(result));
+    for(int i = 0; i < 4; ++i)
+      ASSERT(deque.push(42 + i));
+    ASSERT(!deque.push(46));
+    ASSERT(deque.size() == 4);
+    ASSERT(deque.approx_size() == 4);
+    ASSERT(deque.pop(result));
+    ASSERT(result == 45);
+    ASSERT(deque.steal(result));
+    ASSERT(result == 42);
+    ASSERT(deque.steal(result));
+    ASSERT(result == 43);
+    ASSERT(deque.push(47));
+    ASSERT(deque.pop(result));
+    ASSERT(result == 47);
+    ASSERT(deque.pop(result));
+    ASSERT(result == 44);
+    ASSERT(!deque.pop(result));
+    ASSERT(!deque.steal(result));
+    ASSERT(deque.size() == 0);
+  }
+
+  {
+    // the owner pushes and pops while three thieves steal, every item has to be taken exactly once
+    Q deque(64);
+    StealContext<Q> contexts[3];
+    Thread threads[3];
+    for(int i = 0; i < 3; ++i)
+    {
+      contexts[i].deque = &deque;
+      contexts[i].done = false;
+      contexts[i].items = 0;
+      contexts[i].sum = 0;
+      threads[i].start(thiefThread<Q>, &contexts[i]);
+    }
+    usize items = 0;
+    usize sum = 0;
+    int result;
+    for(int i = 1; i <= testStealItems;)
+      if(deque.push(i))
+      {
+        if(i++ % 3 == 0 && deque.pop(result))
+        {
+          ++items;
+          sum += result;
+        }
+      }
+      else
+        Thread::yield();
+    while(deque.pop(result))
+    {
+      ++items;
+      sum += result;
+    }
+    for(int i = 0; i < 3; ++i)
+    {
+      contexts[i].done = true;
+      threads[i].join();
+      items += contexts[i].items;
+      sum += contexts[i].sum;
+    }
+    ASSERT(items == testStealItems);
+    ASSERT(sum == (usize)testStealItems * (testStealItems + 1) / 2);
+    ASSERT(deque.size() == 0);
+  }
+}
+
+template<class Q> void testQueueLayout(const String& name)
+{
+  Console::printf(_T("Testing %s wrap-around... \n"), (const tchar*)name);
+
+  Q queue(64);
+  int result;
+  for(int i = 0; i < 37; ++i)
+  {
+    ASSERT(queue.push(i));
+    ASSERT(queue.pop(result));
+  }
+  for(int i = 0; i < 3; ++i)
+  {
+    for(int j = 0; j < 64; ++j)
+      ASSERT(queue.push(i * 64 + j));
+    ASSERT(!queue.push(0));
+    for(int j = 0; j < 64; ++j)
+    {
+      ASSERT(queue.pop(result));
+      ASSERT(result == i * 64 + j);
+    }
+    ASSERT(!queue.pop(result));
+  }
+}
+
+static void testCompactCapacity()
+{
+  Console::printf(_T("Testing LockFreeQueueCompact<uint8_t> capacity limit... \n"));
+
+  // 64 slots are the most a uint8_t sequence can tell apart from a stale index, 65 round up to 128
+  LockFreeQueueCompact<int, uint8_t> queue(64);
+  ASSERT(queue.capacity() == 64);
+  bool thrown = false;
+  try
+  {
+    LockFreeQueueCompact<int, uint8_t> oversized(65);
+  }
+  catch(const std::length_error&)
+  {
+    thrown = true;
+  }
+  ASSERT(thrown);
+}
+
+template<class Q> void testQueueBulk(const String& name)
+{
+  Console::printf(_T("Testing %s bulk operations... \n"), (const tchar*)name);
+
+  Q queue(4);
+  int items[] = {42, 43, 44, 45, 46, 47};
+  int result[6];
+  ASSERT(queue.pop_bulk(result, 6) == 0);
+  ASSERT(queue.push_bulk(items, 2) == 2);
+  ASSERT(queue.push_bulk(items + 2, 4) == 2);
+  ASSERT(queue.push_bulk(items + 4, 2) == 0);
+  ASSERT(queue.pop_bulk(result, 3) == 3);
+  ASSERT(result[0] == 42 && result[1] == 43 && result[2] == 44);
+  ASSERT(queue.push_bulk(items + 4, 2) == 2);
+  ASSERT(queue.pop_bulk(result, 6) == 3);
+  ASSERT(result[0] == 45 && result[1] == 46 && result[2] == 47);
+  ASSERT(queue.pop_bulk(result, 6) == 0);
+}
+
+template<class Q> void testQueueInPlace(const String& name)
+{
+  Console::printf(_T("Testing %s in place... \n"), (const tchar*)name);
+
+  Q queue(2);
+  ASSERT(!queue.try_peek());
+  std::string* first = queue.try_reserve();
+  std::string* second = queue.try_reserve();
+  ASSERT(first && second);
+  ASSERT(!queue.try_reserve());
+  new (second) std::string("second");
+  queue.commit(second);
+  ASSERT(!queue.try_peek());
+  new (first) std::string("first");
+  queue.commit(first);
+  const std::string* result = queue.try_peek();
+  ASSERT(result == first && *result == "first");
+  ASSERT(!queue.try_reserve());
+  queue.release(result);
+  std::string* third = queue.try_reserve();
+  ASSERT(third == first);
+  new (third) std::string("third");
+  queue.commit(third);
+
+  std::string value;
+  ASSERT(queue.pop(value) && value == "second");
+  ASSERT(queue.push("fourth"));
+  result = queue.try_peek();
+  ASSERT(result && *result == "third");
+  queue.release(result);
+  result = queue.try_peek();
+  ASSERT(result && *result == "fourth");
+  queue.release(result);
+  ASSERT(!queue.try_peek());
+  ASSERT(queue.size() == 0);
+}
+
+template<class P> uint objectPoolThread(void* param)
+{
+  P* pool = (P*)param;
+  usize* objects[8];
+  usize thread = (usize)Thread::getCurrentThreadId();
+  for(int i = 0; i < testPoolRounds; ++i)
+  {
+    int count = 1 + i % 8;
+    for(int j = 0; j < count; ++j)
+    {
+      while(!(objects[j] = pool->allocate()))
+        Thread::yield();
+      *objects[j] = thread + j;
+    }
+    for(int j = 0; j < count; ++j)
+    {
+      // an object handed out twice would have been overwritten by the other thread
+      ASSERT(*objects[j] == thread + j);
+      pool->deallocate(objects[j]);
+    }
+  }
+  return 0;
+}
+
+// leaves the objects it took from the shared stack in its magazine
+template<class P> uint objectPoolCacheThread(void* param)
+{
+  P* pool = (P*)param;
+  usize* object = pool->allocate();
+  ASSERT(object);
+  pool->deallocate(object);
+  return 0;
+}
+
+template<usize M, usize N> void testObjectPool(const String& name)
+{
+  typedef LockFreeObjectPool<std::string, M, N> P;
+
+  Console::printf(_T("Testing %s... \n"), (const tchar*)name);
+
+  {
+    P pool(100);
+    std::string* objects[100];
+    for(int i = 0; i < 100; ++i)
+    {
+      objects[i] = pool.create("object");
+      ASSERT(objects[i]);
+      for(int j = 0; j < i; ++j)
+        ASSERT(objects[j] != objects[i]);
+    }
+    ASSERT(!pool.allocate());
+    for(int i = 0; i < 100; ++i)
+      pool.destroy(objects[i]);
+    for(int i = 0; i < 100; ++i)
+      ASSERT((objects[i] = pool.create("again")));
+    ASSERT(!pool.allocate());
+    for(int i = 0; i < 100; ++i)
+      pool.destroy(objects[i]);
+  }
+
+  {
+    // the objects cached by a thread that has exited are handed out before the pool reports exhaustion
+    LockFreeObjectPool<usize, M, N> pool(M * 2);
+    Thread thread;
+    thread.start(objectPoolCacheThread<LockFreeObjectPool<usize, M, N> >, &pool);
+    thread.join();
+    usize* objects[M * 2];
+    for(usize i = 0; i < M * 2; ++i)
+      ASSERT((objects[i] = pool.allocate()));
+    ASSERT(!pool.allocate());
+    for(usize i = 0; i < M * 2; ++i)
+      pool.deallocate(objects[i]);
+  }
+
+  {
+    LockFreeObjectPool<usize, M, N> pool(testPoolThreads * 8 + M * N);
+    Thread threads[testPoolThreads];
+    for(int i = 0; i < testPoolThreads; ++i)
+      threads[i].start(objectPoolThread<LockFreeObjectPool<usize, M, N> >, &pool);
+    for(int i = 0; i < testPoolThreads; ++i)
+      threads[i].join();
+  }
+}
+
+template<class Q> void testByteQueue(const String& name)
+{
+  Console::printf(_T("Testing %s... \n"), (const tchar*)name);
+
+  Q queue(256);
+  usize size;
+  ASSERT(queue.capacity() == 256);
+  ASSERT(queue.maxSize() == 128);
+  ASSERT(!queue.reserve(129));
+  ASSERT(!queue.read(size));
+
+  // records become readable in ring order, no matter in which order they are committed
+  char* first = (char*)queue.reserve(10);
+  char* second = (char*)queue.reserve(40);
+  ASSERT(first && second && second == first + 16);
+  ASSERT((usize)first % 16 == 0);
+  queue.commit(second);
+  ASSERT(!queue.read(size));
+  queue.commit(first);
+  ASSERT(queue.read(size) == first && size == 10);
+  ASSERT(queue.read(size) == second && size == 40);
+  ASSERT(!queue.read(size));
+
+  // and their space is reclaimed in ring order, no matter in which order they are released
+  ASSERT(queue.size() == 64);
+  queue.release(second);
+  ASSERT(queue.size() == 64);
+  queue.release(first);
+  ASSERT(queue.size() == 0);
+
+  // records of varying size never straddle the end of the buffer
+  uint32 random = 1;
+  usize pushed = 0, popped = 0;
+  usize sizes[16];
+  for(int i = 0; i < 1000; ++i)
+  {
+    random = random * 1103515245 + 12345;
+    usize recordSize = 1 + (random >> 16) % 128;
+    if(char* data = (char*)queue.reserve(recordSize))
+    {
+      ASSERT(data + recordSize <= first + queue.capacity());
+      for(usize j = 0; j < recordSize; ++j)
+        data[j] = (char)(pushed + j);
+      queue.commit(data);
+      sizes[pushed++ % 16] = recordSize;
+    }
+    if(random & 0x80000000 || pushed - popped == 16)
+      while(const char* data = (const char*)queue.read(size))
+      {
+        ASSERT(size == sizes[popped % 16]);
+        for(usize j = 0; j < size; ++j)
+          ASSERT(data[j] == (char)(popped + j));
+        queue.release(data);
+        ++popped;
+      }
+  }
+  ASSERT(pushed > 500);
+  while(const void* data = queue.read(size))
+  {
+    queue.release(data);
+    ++popped;
+  }
+  ASSERT(popped == pushed);
+  ASSERT(queue.size() == 0);
+}
+
+#ifndef _WIN32
+static void testSharedMemoryQueue()
+{
+  Console::printf(_T("Testing SharedMemoryQueue... \n"));
+
+  String name;
+  name.printf(_T("/LockFreeQueueTest.%d"), (int)getpid());
+  SharedMemoryQueue<int> producer;
+  SharedMemoryQueue<int> consumer;
+  ASSERT(!consumer.open(name, 0));
+  ASSERT(producer.create(name, 3));
+  ASSERT(producer.capacity() == 4);
+
+  // a segment created for another element type must not be attached
+  SharedMemoryQueue<int64> mismatch;
+  ASSERT(!mismatch.open(name, 0));
+  ASSERT(!mismatch.isOpen());
+
+  ASSERT(consumer.open(name, 0));
+  ASSERT(consumer.capacity() == 4);
+  int result;
+  ASSERT(!consumer.pop(result));
+  for(int i = 0; i < 4; ++i)
+    ASSERT(producer.push(i));
+  ASSERT(!producer.push(4));
+  ASSERT(consumer.size() == 4);
+  for(int i = 0; i < 4; ++i)
+  {
+    ASSERT(consumer.pop(result));
+    ASSERT(result == i);
+    ASSERT(producer.push(i + 4));
+  }
+  for(int i = 4; i < 8; ++i)
+  {
+    ASSERT(consumer.pop(result));
+    ASSERT(result == i);
+  }
+  ASSERT(!consumer.pop(result));
+
+  // a segment whose creator is alive is not replaced
+  SharedMemoryQueue<int> replacement;
+  ASSERT(!replacement.create(name, 4));
+  ASSERT(!replacement.isOpen());
+
+  ASSERT(SharedMemoryQueue<int>::unlink(name));
+  ASSERT(!SharedMemoryQueue<int>::unlink(name));
+
+  // a segment left behind by a process that has exited is replaced
+  pid_t pid = fork();
+  if(pid == 0)
+  {
+    SharedMemoryQueue<int> orphan;
+    _exit(orphan.create(name, 4) ? 0 : 1);
+  }
+  int status;
+  ASSERT(pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  ASSERT(replacement.create(name, 4));
+  ASSERT(!replacement.pop(result));
+  ASSERT(SharedMemoryQueue<int>::unlink(name));
+}
+#endif
+
+static void test()
+{
+  testQueue<LockFreeQueueCpp11<int> >("LockFreeQueueCpp11");
+  testQueue<LockFreeQueueCpp11<int, Producers::Multi, Consumers::Single> >("LockFreeQueueCpp11<Multi, Single>");
+  testQueue<LockFreeQueueCpp11<int, Producers::Single, Consumers::Multi> >("LockFreeQueueCpp11<Single, Multi>");
+  testQueue<LockFreeQueueCpp11<int, Producers::Single, Consumers::Single> >("LockFreeQueueCpp11<Single, Single>");
+  testQueue<LockFreeQueueCompact<int> >("LockFreeQueueCompact");
+  testQueue<LockFreeQueueCompact<int, uint32_t> >("LockFreeQueueCompact<uint32_t>");
+  testQueue<LockFreeQueueCompact<int, size_t, Producers::Single, Consumers::Single> >("LockFreeQueueCompact<Single, Single>");
+  testQueue<mpmc_bounded_queue<int> >("mpmc_bounded_queue");
+  testQueue<LockFreeQueueScq<int> >("LockFreeQueueScq");
+  testQueue<LockFreeQueue<int> >("LockFreeQueue");
+  testQueue<LockFreeQueueSlow1<int> >("LockFreeQueueSlow1");
+  testQueue<LockFreeQueueSlow2<int> >("LockFreeQueueSlow2");
+  testQueue<LockFreeQueueSlow3<int> >("LockFreeQueueSlow3");
+  testQueue<MutexLockQueue<int> >("MutexLockQueue");
+  testQueue<SpinLockQueue<int> >("SpinLockQueue");
+  testQueue<LockFreeLifoQueue<int> >("LockFreeLifoQueue", true);
+  testQueue<LockFreeLifoQueue<int, 4, 16> >("LockFreeLifoQueue<4, 16>", true);
+  testQueue<LockFreeSpscQueue<int> >("LockFreeSpscQueue");
+  testQueue<LockFreeUnboundedQueue<int> >("LockFreeUnboundedQueue");
+  testQueue<BlockingQueue<int, LockFreeQueueCpp11<int> > >("BlockingQueue<LockFreeQueueCpp11>");
+  testQueue<BlockingQueue<int, LockFreeQueue<int> > >("BlockingQueue<LockFreeQueue>");
+  testQueue<CountedQueue<int> >("CountedQueue<LockFreeQueueCpp11>");
+  testQueue<CountedQueue<int, LockFreeLifoQueue<int> > >("CountedQueue<LockFreeLifoQueue>", true);
+  testQueue<ShardedQueue<int> >("ShardedQueue<LockFreeQueueCpp11>");
+
+  testQueueLayout<LockFreeQueueCpp11<int, Producers::Multi, Consumers::Multi, HeapAllocator, Layouts::Padded> >("LockFreeQueueCpp11<Padded>");
+  testQueueLayout<LockFreeQueueCpp11<int, Producers::Multi, Consumers::Multi, HeapAllocator, Layouts::Remapped> >("LockFreeQueueCpp11<Remapped>");
+  testQueueLayout<LockFreeQueue<int, Layouts::Padded> >("LockFreeQueue<Padded>");
+  testQueueLayout<LockFreeQueue<int, Layouts::Remapped> >("LockFreeQueue<Remapped>");
+  testQueueLayout<LockFreeQueueCompact<int, uint8_t> >("LockFreeQueueCompact<uint8_t>");
+  testCompactCapacity();
+
+  testQueueBulk<LockFreeQueueCpp11<int> >("LockFreeQueueCpp11");
+  testQueueBulk<LockFreeQueueCpp11<int, Producers::Multi, Consumers::Multi, HeapAllocator, Layouts::Remapped> >("LockFreeQueueCpp11<Remapped>");
+  testQueueBulk<LockFreeQueueCompact<int> >("LockFreeQueueCompact");
+  testQueueBulk<LockFreeSpscQueue<int> >("LockFreeSpscQueue");
+
+  testUnboundedQueue<LockFreeUnboundedQueue<int> >("LockFreeUnboundedQueue");
+
+  testPriorityQueue<PriorityLockFreeQueue<int, 4> >("PriorityLockFreeQueue<4>");
+  testPriorityQueue<PriorityLockFreeQueue<int, 64, LockFreeQueueCompact<int> > >("PriorityLockFreeQueue<64, LockFreeQueueCompact>");
+
+  testSizeUnderLoad<LockFreeQueueCpp11<int> >("LockFreeQueueCpp11");
+  testSizeUnderLoad<LockFreeLifoQueue<int> >("LockFreeLifoQueue");
+  testSizeUnderLoad<MutexLockQueue<int> >("MutexLockQueue");
+  testSizeUnderLoad<CountedQueue<int> >("CountedQueue<LockFreeQueueCpp11>");
+  testSizeUnderLoad<ShardedQueue<int> >("ShardedQueue<LockFreeQueueCpp11>");
+  testSizeUnderLoad<ShardedQueue<int, mpmc_bounded_queue<int>, 3> >("ShardedQueue<mpmc_bounded_queue, 3>");
+
+  testShardedQueue<ShardedQueue<int, LockFreeQueueCpp11<int>, 4> >("ShardedQueue<LockFreeQueueCpp11, 4>");
+
+  testWorkStealingDeque<WorkStealingDeque<int> >("WorkStealingDeque");
+
+  testBroadcastQueue<BroadcastQueue<int> >("BroadcastQueue");
+
+  testOverwriteQueue<OverwriteQueue<int> >("OverwriteQueue<LockFreeQueueCpp11>");
+  testOverwriteQueue<OverwriteQueue<int, mpmc_bounded_queue<int> > >("OverwriteQueue<mpmc_bounded_queue>");
+  testConflatingQueue<ConflatingQueue<int> >("ConflatingQueue");
+
+  testQueueInPlace<LockFreeQueueCpp11<std::string> >("LockFreeQueueCpp11");
+  testQueueInPlace<LockFreeQueueCpp11<std::string, Producers::Single, Consumers::Single, HeapAllocator, Layouts::Remapped> >("LockFreeQueueCpp11<Single, Single, Remapped>");
+
+  testByteQueue<LockFreeByteQueue<> >("LockFreeByteQueue");
+  testByteQueue<LockFreeByteQueue<Producers::Single, Consumers::Single> >("LockFreeByteQueue<Single, Single>");
+
+  testMoveOnlyQueue<LockFreeQueueCpp11<std::unique_ptr<int> >, LockFreeQueueCpp11<std::string> >("LockFreeQueueCpp11");
+  testMoveOnlyQueue<LockFreeQueueCompact<std::unique_ptr<int> >, LockFreeQueueCompact<std::string> >("LockFreeQueueCompact");
+  testMoveOnlyQueue<mpmc_bounded_queue<std::unique_ptr<int> >, mpmc_bounded_queue<std::string> >("mpmc_bounded_queue");
+  testMoveOnlyQueue<LockFreeQueueScq<std::unique_ptr<int> >, LockFreeQueueScq<std::string> >("LockFreeQueueScq");
+
+  testBlockingQueue<BlockingQueue<int, LockFreeQueueCpp11<int> > >("BlockingQueue<LockFreeQueueCpp11>");
+  testBlockingQueue<BlockingQueue<int, LockFreeQueue<int> > >("BlockingQueue<LockFreeQueue>");
+
+  testTimedQueue<LockFreeQueueCpp11<int, Producers::Multi, Consumers::Multi, HeapAllocator, Layouts::Packed, Backoffs::Spin> >("LockFreeQueueCpp11<Spin>");
+  testTimedQueue<LockFreeQueueCpp11<int> >("LockFreeQueueCpp11<Yield>");
+  testTimedQueue<LockFreeQueueCpp11<int, Producers::Multi, Consumers::Multi, HeapAllocator, Layouts::Packed, Backoffs::Sleep> >("LockFreeQueueCpp11<Sleep>");
+  testTimedQueue<LockFreeQueueCpp11<int, Producers::Multi, Consumers::Multi, HeapAllocator, Layouts::Packed, Backoffs::Park> >("LockFreeQueueCpp11<Park>");
+  testTimedQueue<mpmc_bounded_queue<int, Backoffs::Spin> >("mpmc_bounded_queue<Spin>");
+  testTimedQueue<mpmc_bounded_queue<int> >("mpmc_bounded_queue<Yield>");
+  testTimedQueue<mpmc_bounded_queue<int, Backoffs::Sleep> >("mpmc_bounded_queue<Sleep>");
+  testTimedQueue<mpmc_bounded_queue<int, Backoffs::Park> >("mpmc_bounded_queue<Park>");
+
+  testObjectPool<32, 64>("LockFreeObjectPool");
+  testObjectPool<4, 1>("LockFreeObjectPool<4, 1>");
+
+#ifndef _WIN32
+  testSharedMemoryQueue();
+#endif
+}
+
+static void testWake()
+{
+  testWakeLatency<LockFreeQueueCpp11<int64> >("LockFreeQueueCpp11 (yield)", yieldWakeConsumerThread<LockFreeQueueCpp11<int64> >);
+  testWakeLatency<BlockingQueue<int64, LockFreeQueueCpp11<int64> > >("BlockingQueue<LockFreeQueueCpp11>", blockingWakeConsumerThread<BlockingQueue<int64, LockFreeQueueCpp11<int64> > >);
+  testWakeLatency<LockFreeQueue<int64> >("LockFreeQueue (yield)", yieldWakeConsumerThread<LockFreeQueue<int64> >);
+  testWakeLatency<BlockingQueue<int64, LockFreeQueue<int64> > >("BlockingQueue<LockFreeQueue>", blockingWakeConsumerThread<BlockingQueue<int64, LockFreeQueue<int64> > >);
+}
+
+template<class Q> typename std::enable_if<std::is_constructible<Q, usize, BenchmarkAllocator>::value, Q*>::type newQueue()
+{
+  return new Q(options.capacity, BenchmarkAllocator(options.memoryNode));
+}
+
+template<class Q> typename std::enable_if<!std::is_constructible<Q, usize, BenchmarkAllocator>::value, Q*>::type newQueue()
+{
+  return new Q(options.capacity);
+}
+
+static std::vector<int> coreCpus(const std::vector<Affinity::Cpu>& cpus, int socket)
+{
+  std::vector<int> result;
+  for(size_t i = 0; i < cpus.size(); ++i)
+    if(cpus[i].socket == socket && (i == 0 || cpus[i - 1].socket != socket || cpus[i - 1].core != cpus[i].core))
+      result.push_back(cpus[i].id);
+  return result;
+}
+
+static bool assignCpus(Topology topology, int producers, int consumers, std::vector<int>& producerCpus, std::vector<int>& consumerCpus)
+{
+  producerCpus.assign(producers, -1);
+  consumerCpus.assign(consumers, -1);
+  if(topology == noAffinity)
+    return true;
+
+  std::vector<Affinity::Cpu> cpus = Affinity::cpus();
+  std::vector<int> producerSet, consumerSet;
+  if(cpus.empty())
+    return false;
+  if(topology == smtAffinity)
+  {
+    // all producers on one hardware thread, all consumers on its sibling
+    for(size_t i = 0; i + 1 < cpus.size(); ++i)
+      if(cpus[i].socket == cpus[i + 1].socket && cpus[i].core == cpus[i + 1].core)
+      {
+        producerSet.push_back(cpus[i].id);
+        consumerSet.push_back(cpus[i + 1].id);
+        break;
+      }
+  }
+  else if(topology == socketAffinity)
+  {
+    // one thread per core of the first socket, the consumers continue where the producers end
+    producerSet = coreCpus(cpus, cpus[0].socket);
+    for(size_t i = 0; i < producerSet.size(); ++i)
+      consumerSet.push_back(producerSet[(producers + i) % producerSet.size()]);
+  }
+  else if(topology == crossSocketAffinity)
+  {
+    // producers on the first socket, consumers on the next one
+    producerSet = coreCpus(cpus, cpus[0].socket);
+    consumerSet = coreCpus(cpus, cpus.back().socket);
+    if(cpus.back().socket == cpus[0].socket)
+      consumerSet.clear();
+  }
+  if(producerSet.empty() || consumerSet.empty())
+    return false;
+  for(int i = 0; i < producers; ++i)
+    producerCpus[i] = producerSet[i % producerSet.size()];
+  for(int i = 0; i < consumers; ++i)
+    consumerCpus[i] = consumerSet[i % consumerSet.size()];
+  return true;
+}
+
+// a workload provides the queue, the thread bodies and the checks of a benchmark, runBenchmark and benchmark do the rest
+// finish returns the number of items the throughput is counted in, print reports what the workload measures besides it
+template<class Q, typename T> struct QueueWorkload
+{
+  typedef Q Queue;
+
+  static Q* create(int) {return newQueue<Q>();}
+  static uint producer(void* param) {return producerThread<Q, T>(param);}
+  static uint consumer(void* param) {return consumerThread<Q, T>(param);}
+
+  static usize finish(Q& queue, int, RunResult&)
+  {
+    ASSERT(queue.size() == 0);
+    ASSERT(producerSum == consumerSum);
+    ASSERT(producerItems == consumerItems);
+    return consumerItems;
+  }
+
+  static void print(const RunResult&) {}
+};
+
+template<class Q, typename T> struct BulkQueueWorkload : QueueWorkload<Q, T>
+{
+  static uint producer(void* param) {return bulkProducerThread<Q, T>(param);}
+  static uint consumer(void* param) {return bulkConsumerThread<Q, T>(param);}
+};
+
+template<class W, bool producer> uint workloadThread(void* param)
+{
+  pinThread<typename W::Queue>(param);
+  return producer ? W::producer(param) : W::consumer(param);
+}
+
+template<class W> RunResult runBenchmark(const std::vector<int>& producerCpus, const std::vector<int>& consumerCpus, LatencyHistograms* latency)
+{
+  typedef typename W::Queue Q;
+  int producers = (int)producerCpus.size();
+  int consumers = (int)consumerCpus.size();
+  producerSum = 0;
+  consumerSum = 0;
+  producerItems = 0;
+  consumerItems = 0;
+  benchmarkStopped = 0;
+  runningProducers = producers;
+
+  RunResult result;
+  result.dropRate = 0.;
+  int64 microDuration;
+  usize items;
+  int64 cpuStartTime = cpuMicroTicks();
+  {
+    allocatedBytes = 0;
+    Q* queue = W::create(consumers);
+    List<Thread*> threads;
+    List<BenchmarkContext<Q>*> contexts;
+    for(int i = 0; i < consumers + producers; ++i)
+    {
+      BenchmarkContext<Q>* context = new BenchmarkContext<Q>;
+      context->queue = queue;
+      context->cpu = i < consumers ? consumerCpus[i] : producerCpus[i - consumers];
+      context->index = i < consumers ? i : i - consumers;
+      contexts.append(context);
+    }
+    typename List<BenchmarkContext<Q>*>::Iterator context = contexts.begin();
+    int64 microStartTime = Time::microTicks();
+    for(int i = 0; i < consumers; ++i, ++context)
+    {
+      Thread* thread = new Thread;
+      thread->start(workloadThread<W, false>, *context);
+      threads.append(thread);
+    }
+    for(int i = 0; i < producers; ++i, ++context)
+    {
+      Thread* thread = new Thread;
+      thread->start(workloadThread<W, true>, *context);
+      threads.append(thread);
+    }
+    Thread::sleep(options.duration);
+    Atomic::store(benchmarkStopped, 1);
+    for(List<Thread*>::Iterator i = threads.begin(), end = threads.end(); i != end; ++i)
+    {
+      Thread* thread = *i;
+      thread->join();
+      delete thread;
+    }
+    microDuration = Time::microTicks() - microStartTime;
+    for(typename List<BenchmarkContext<Q>*>::Iterator i = contexts.begin(), end = contexts.end(); i != end; ++i)
+    {
+      if(latency)
+        latency->merge((*i)->latency);
+      delete *i;
+    }
+    items = W::finish(*queue, consumers, result);
+    delete queue;
+  }
+  result.cpuLoad = (double)(cpuMicroTicks() - cpuStartTime) / (double)(microDuration ? microDuration : 1);
+  result.opsPerSecond = (double)items * 1000000. / (double)(microDuration ? microDuration : 1);
+  return result;
+}
+
+static Latency summarizeLatency(const LatencyHistogram& histogram)
+{
+  double nanosecondsPerTick = CycleClock::nanosecondsPerTick();
+  Latency latency;
+  latency.p50 = (double)histogram.percentile(50.) * nanosecondsPerTick;
+  latency.p99 = (double)histogram.percentile(99.) * nanosecondsPerTick;
+  latency.p999 = (double)histogram.percentile(99.9) * nanosecondsPerTick;
+  latency.p9999 = (double)histogram.percentile(99.99) * nanosecondsPerTick;
+  latency.max = (double)histogram.maximum() * nanosecondsPerTick;
+  return latency;
+}
+
+static void printLatency(const tchar* name, const Latency& latency)
+{
+  Console::printf(_T("  %s: p50 %.0f ns, p99 %.0f ns, p99.9 %.0f ns, p99.99 %.0f ns, max %.0f ns\n"), name, latency.p50, latency.p99, latency.p999, latency.p9999, latency.max);
+}
+
+static void summarizeResult(Result& result, double sum, double squareSum, const LatencyHistograms& latency)
+{
+  result.meanOpsPerSecond = sum / options.repeats;
+  double variance = options.repeats > 1 ? (squareSum - sum * result.meanOpsPerSecond) / (options.repeats - 1) : 0.;
+  result.stddevOpsPerSecond = variance > 0. ? std::sqrt(variance) : 0.;
+  result.push = summarizeLatency(latency.push);
+  result.pop = summarizeLatency(latency.pop);
+  result.endToEnd = summarizeLatency(latency.endToEnd);
+
+  Console::printf(_T("%.0f ops/s (stddev %.0f)\n"), result.meanOpsPerSecond, result.stddevOpsPerSecond);
+  if(result.ringBytes)
+    Console::printf(_T("  ring: %llu bytes, %.1f bytes per slot\n"), (uint64)result.ringBytes, (double)result.ringBytes / (double)options.capacity);
+  printLatency(_T("push"), result.push);
+  printLatency(_T("pop"), result.pop);
+  printLatency(_T("end-to-end"), result.endToEnd);
+}
+
+template<class W> void benchmark(const String& name, usize payload, int producers, int consumers, Topology topology)
+{
+  typedef typename W::Queue Q;
+  std::vector<int> producerCpus, consumerCpus;
+  if(!assignCpus(topology, producers, consumers, producerCpus, consumerCpus))
+  {
+    Console::printf(_T("Skipping %s (%dx%d, %s): topology not available\n"), (const tchar*)name, producers, consumers, topologyNames[topology]);
+    return;
+  }
+
+  Result& result = results.append(Result());
+  result.queue = name;
+  result.payload = payload;
+  result.producers = producers;
+  result.consumers = consumers;
+  result.topology = topology;
+  result.memoryNode = std::is_constructible<Q, usize, BenchmarkAllocator>::value ? options.memoryNode : -1;
+  result.capacity = options.capacity;
+  result.runs = options.repeats;
+
+  Console::printf(_T("Benchmarking %s (%dx%d, %d bytes, %s)... \n"), (const tchar*)name, producers, consumers, (int)payload, topologyNames[topology]);
+
+  for(int i = 0; i < options.warmups; ++i)
+    runBenchmark<W>(producerCpus, consumerCpus, 0);
+
+  LatencyHistograms* latency = new LatencyHistograms;
+  double sum = 0., squareSum = 0.;
+  RunResult mean = {0., 0., 0.};
+  for(int i = 0; i < options.repeats; ++i)
+  {
+    RunResult run = runBenchmark<W>(producerCpus, consumerCpus, latency);
+    sum += run.opsPerSecond;
+    squareSum += run.opsPerSecond * run.opsPerSecond;
+    mean.dropRate += run.dropRate;
+    mean.cpuLoad += run.cpuLoad;
+  }
+  result.ringBytes = allocatedBytes;
+  summarizeResult(result, sum, squareSum, *latency);
+  mean.opsPerSecond = result.meanOpsPerSecond;
+  mean.dropRate /= options.repeats;
+  mean.cpuLoad /= options.repeats;
+  result.dropRate = mean.dropRate;
+  result.cpuLoad = mean.cpuLoad;
+  W::print(mean);
+  delete latency;
+}
+
+template<class A> void benchmarkColdStart(const String& name, const A& allocator)
+{
+  typedef LockFreeQueueCpp11<int, Producers::Multi, Consumers::Multi, A> Q;
+
+  Console::printf(_T("Cold start %s (%llu slots)... \n"), (const tchar*)name, (uint64)options.capacity);
+
+  LatencyHistograms* latency = new LatencyHistograms;
+  uint64 constructionTicks = 0;
+  for(int i = 0; i < options.repeats; ++i)
+  {
+    uint64 startTime = CycleClock::now();
+    Q* queue = new Q(options.capacity, allocator);
+    constructionTicks += CycleClock::now() - startTime;
+    int result;
+    for(usize j = 0, capacity = queue->capacity(); j < capacity; ++j)
+    {
+      startTime = CycleClock::now();
+      queue->push((int)j);
+      latency->push.record(CycleClock::now() - startTime);
+    }
+    for(usize j = 0, capacity = queue->capacity(); j < capacity; ++j)
+    {
+      startTime = CycleClock::now();
+      queue->pop(result);
+      latency->pop.record(CycleClock::now() - startTime);
+    }
+    delete queue;
+  }
+
+  Console::printf(_T("construction: %.3f ms\n"), (double)constructionTicks * CycleClock::nanosecondsPerTick() / 1000000. / options.repeats);
+  printLatency(_T("first push"), summarizeLatency(latency->push));
+  printLatency(_T("first pop"), summarizeLatency(latency->pop));
+  delete latency;
+}
+
+static void benchmarkColdStarts()
+{
+  benchmarkColdStart("HeapAllocator", HeapAllocator());
+  benchmarkColdStart("NumaAllocator", NumaAllocator(options.memoryNode));
+  benchmarkColdStart("HugePageAllocator", HugePageAllocator(0));
+  benchmarkColdStart("HugePageAllocator (prefault)", HugePageAllocator(HugePageAllocator::prefault));
+  benchmarkColdStart("HugePageAllocator (prefault, lock)", HugePageAllocator(HugePageAllocator::prefault | HugePageAllocator::lock));
+}
+
+// a task is its depth in the graph, every task spins for a while before it spawns its children
+enum TaskGraph
+{
+  fibonacciGraph, // a task of depth d spawns d-1 and d-2
+  binomialGraph, // a task of depth d spawns 0, 1, ..., d-1
+};
+
+static const uint32 schedulerWork = 256;
+static volatile uint32 schedulerSink;
+
+static usize taskCount(TaskGraph graph, uint32 depth)
+{
+  if(graph == binomialGraph)
+    return (usize)1 << depth;
+  usize previous = 1, count = 1;
+  for(uint32 i = 1; i < depth; ++i)
+  {
+    usize next = count + previous + 1;
+    previous = count;
+    count = next;
+  }
+  return count;
+}
+
+// every worker owns a deque and steals from the others when it runs dry
+class StealingScheduler
+{
+public:
+  StealingScheduler(int workers, usize capacity) : _workers(workers)
+  {
+    for(int i = 0; i < workers; ++i)
+      _deques.push_back(new WorkStealingDeque<uint32>(capacity));
+  }
+
+  ~StealingScheduler()
+  {
+    for(int i = 0; i < _workers; ++i)
+      delete _deques[i];
+  }
+
+  bool push(int worker, uint32 task) {return _deques[worker]->push(task);}
+
+  bool pop(int worker, uint32& task)
+  {
+    if(_deques[worker]->pop(task))
+      return true;
+    for(int i = 1; i < _workers; ++i)
+      if(_deques[(worker + i) % _workers]->steal(task))
+        return true;
+    return false;
+  }
+
+private:
+  int _workers;
+  std::vector<WorkStealingDeque<uint32>*> _deques;
+};
+
+// all workers share a single ring
+class SharedScheduler
+{
+public:
+  SharedScheduler(int, usize capacity) : _queue(capacity) {}
+
+  bool push(int, uint32 task) {return _queue.push(task);}
+  bool pop(int, uint32& task) {return _queue.pop(task);}
+
+private:
+  LockFreeQueueCpp11<uint32> _queue;
+};
+
+template<class S> struct SchedulerContext
+{
+  S* scheduler;
+  TaskGraph graph;
+  std::atomic<usize> pending;
+};
+
+template<class S> struct SchedulerWorker
+{
+  SchedulerContext<S>* context;
+  int index;
+  usize tasks;
+};
+
+template<class S> void runTask(SchedulerWorker<S>& worker, uint32 task)
+{
+  uint32 value = task;
+  for(uint32 i = 0; i < schedulerWork; ++i)
+    value = value * 1103515245 + 12345;
+  schedulerSink = value;
+  ++worker.tasks;
+
+  SchedulerContext<S>& context = *worker.context;
+  uint32 first = context.graph == fibonacciGraph && task > 2 ? task - 2 : 0;
+  uint32 children = context.graph == fibonacciGraph ? (task >= 2 ? 2 : 0) : task;
+  if(children)
+    context.pending.fetch_add(children, std::memory_order_relaxed);
+  for(uint32 child = first; child < first + children; ++child)
+    if(!context.scheduler->push(worker.index, child))
+      runTask(worker, child);
+  context.pending.fetch_sub(1, std::memory_order_release);
+}
+
+template<class S> uint schedulerThread(void* param)
+{
+  SchedulerWorker<S>& worker = *(SchedulerWorker<S>*)param;
+  uint32 task;
+  while(worker.context->pending.load(std::memory_order_acquire))
+    if(worker.context->scheduler->pop(worker.index, task))
+      runTask(worker, task);
+    else
+      Thread::yield();
+  return 0;
+}
+
+template<class S> void benchmarkScheduler(const String& name, TaskGraph graph, uint32 depth, int workers)
+{
+  Console::printf(_T("Scheduler %s (%d workers, %llu tasks)... \n"), (const tchar*)name, workers, (uint64)taskCount(graph, depth));
+
+  double sum = 0., squareSum = 0.;
+  for(int i = -options.warmups; i < options.repeats; ++i)
+  {
+    S scheduler(workers, options.capacity);
+    SchedulerContext<S> context;
+    context.scheduler = &scheduler;
+    context.graph = graph;
+    context.pending.store(1, std::memory_order_relaxed);
+    std::vector<SchedulerWorker<S> > states(workers);
+    Thread* threads = new Thread[workers];
+
+    // the whole graph unfolds from the root task given to the first worker
+    uint64 startTime = CycleClock::now();
+    scheduler.push(0, depth);
+    for(int j = 0; j < workers; ++j)
+    {
+      states[j].context = &context;
+      states[j].index = j;
+      states[j].tasks = 0;
+      threads[j].start(schedulerThread<S>, &states[j]);
+    }
+    usize tasks = 0;
+    for(int j = 0; j < workers; ++j)
+    {
+      threads[j].join();
+      tasks += states[j].tasks;
+    }
+    double seconds = (double)(CycleClock::now() - startTime) * CycleClock::nanosecondsPerTick() / 1000000000.;
+    delete[] threads;
+    ASSERT(tasks == taskCount(graph, depth));
+    if(i < 0)
+      continue;
+    double tasksPerSecond = (double)tasks / seconds;
+    sum += tasksPerSecond;
+    squareSum += tasksPerSecond * tasksPerSecond;
+  }
+  double mean = sum / options.repeats;
+  double variance = options.repeats > 1 ? (squareSum - sum * mean) / (options.repeats - 1) : 0.;
+  Console::printf(_T("%.0f tasks/s (stddev %.0f)\n"), mean, variance > 0. ? std::sqrt(variance) : 0.);
+}
+
+static void benchmarkSchedulers()
+{
+  for(List<ThreadConfig>::Iterator i = options.threads.begin(), end = options.threads.end(); i != end; ++i)
+  {
+    int workers = i->producers + i->consumers;
+    benchmarkScheduler<StealingScheduler>("WorkStealingDeque (fibonacci)", fibonacciGraph, 25, workers);
+    benchmarkScheduler<SharedScheduler>("LockFreeQueueCpp11 (fibonacci)", fibonacciGraph, 25, workers);
+    benchmarkScheduler<StealingScheduler>("WorkStealingDeque (binomial)", binomialGraph, 18, workers);
+    benchmarkScheduler<SharedScheduler>("LockFreeQueueCpp11 (binomial)", binomialGraph, 18, workers);
+  }
+}
+
+static bool isSelected(const String& name)
+{
+  if(options.queues.isEmpty())
+    return true;
+  for(List<String>::Iterator i = options.queues.begin(), end = options.queues.end(); i != end; ++i)
+    if(*i == name)
+      return true;
+  return false;
+}
+
+template<template<class, typename> class W, template<typename> class Q> void benchmarkPayloads(const String& name, int producers, int consumers, Topology topology)
+{
+  for(List<usize>::Iterator j = options.payloads.begin(), end = options.payloads.end(); j != end; ++j)
+    switch(*j)
     {
-      Thread* thread = *i;
-      thread->join();
-      delete thread;
+    case 4: benchmark<W<Q<int>, int> >(name, *j, producers, consumers, topology); break;
+    case 8: benchmark<W<Q<int64>, int64> >(name, *j, producers, consumers, topology); break;
+    case 16: benchmark<W<Q<Payload<16> >, Payload<16> > >(name, *j, producers, consumers, topology); break;
+    case 64: benchmark<W<Q<Payload<64> >, Payload<64> > >(name, *j, producers, consumers, topology); break;
+    case 256: benchmark<W<Q<Payload<256> >, Payload<256> > >(name, *j, producers, consumers, topology); break;
+    case 1024: benchmark<W<Q<Payload<1024> >, Payload<1024> > >(name, *j, producers, consumers, topology); break;
+    case 4096: benchmark<W<Q<Payload<4096> >, Payload<4096> > >(name, *j, producers, consumers, topology); break;
+    }
+}
+
+template<template<class, typename> class W, template<typename> class Q> void benchmarkQueue(const String& name, int maxProducers = 0, int maxConsumers = 0)
+{
+  if(!isSelected(name))
+    return;
+  for(List<ThreadConfig>::Iterator i = options.threads.begin(), end = options.threads.end(); i != end; ++i)
+  {
+    int producers = maxProducers && i->producers > maxProducers ? maxProducers : i->producers;
+    int consumers = maxConsumers && i->consumers > maxConsumers ? maxConsumers : i->consumers;
+    for(List<Topology>::Iterator k = options.topologies.begin(), end = options.topologies.end(); k != end; ++k)
+      benchmarkPayloads<W, Q>(name, producers, consumers, *k);
+  }
+}
+
+// every subscriber has to receive every element, a producer waits until its element is delivered
+template<typename T> class BroadcastSubscribers
+{
+public:
+  BroadcastSubscribers(usize capacity, int subscribers) : queue(capacity, subscribers) {}
+
+  usize size() const {return queue.size();}
+
+  bool push(const T& item)
+  {
+    while(!queue.push(item))
+      Thread::yield();
+    return true;
+  }
+
+  usize consume(int subscriber, T* items, usize max) {return queue.pop_bulk(subscriber, items, max);}
+
+private:
+  BroadcastQueue<T> queue;
+};
+
+// the alternative of one LockFreeQueueCpp11 per subscriber, every element is copied into each of them
+template<typename T> class FanOutQueues
+{
+public:
+  FanOutQueues(usize capacity, int subscribers)
+  {
+    for(int i = 0; i < subscribers; ++i)
+      queues.push_back(new LockFreeQueueCpp11<T>(capacity));
+  }
+
+  ~FanOutQueues()
+  {
+    for(usize i = 0; i < queues.size(); ++i)
+      delete queues[i];
+  }
+
+  usize size() const
+  {
+    usize size = 0;
+    for(usize i = 0; i < queues.size(); ++i)
+      size += queues[i]->size();
+    return size;
+  }
+
+  bool push(const T& item)
+  {
+    for(usize i = 0; i < queues.size(); ++i)
+      while(!queues[i]->push(item))
+        Thread::yield();
+    return true;
+  }
+
+  usize consume(int subscriber, T* items, usize max) {return queues[subscriber]->pop_bulk(items, max);}
+
+private:
+  std::vector<LockFreeQueueCpp11<T>*> queues;
+};
+
+// the consumers read with the pop_bulk of their subscriber
+template<class B, typename T> uint broadcastConsumerThread(void* param)
+{
+  BenchmarkContext<B>* context = (BenchmarkContext<B>*)param;
+  T items[testBulkItems];
+  usize sum = 0;
+  usize count = 0;
+  for(;;)
+  {
+    uint64 startTime = CycleClock::now();
+    usize n;
+    while(!(n = context->queue->consume(context->index, items, testBulkItems)) && Atomic::load(runningProducers))
+    {
+      Thread::yield();
+      startTime = CycleClock::now();
+    }
+    if(!n && !(n = context->queue->consume(context->index, items, testBulkItems)))
+      break;
+    uint64 now = CycleClock::now();
+    context->latency.pop.record(now - startTime);
+    for(usize j = 0; j < n; ++j)
+    {
+      context->latency.endToEnd.record(elapsedTicks(items[j], now));
+      sum += (usize)items[j];
+    }
+    count += n;
+  }
+  Atomic::fetchAndAdd(consumerSum, sum);
+  Atomic::fetchAndAdd(consumerItems, count);
+  return 0;
+}
+
+// the throughput is the number of elements published per second, each of them is received by every subscriber
+template<class B, typename T> struct BroadcastWorkload
+{
+  typedef B Queue;
+
+  static B* create(int subscribers) {return new B(options.capacity, subscribers);}
+  static uint producer(void* param) {return producerThread<B, T>(param);}
+  static uint consumer(void* param) {return broadcastConsumerThread<B, T>(param);}
+
+  static usize finish(B& queue, int subscribers, RunResult&)
+  {
+    ASSERT(queue.size() == 0);
+    ASSERT(consumerSum == producerSum * subscribers);
+    ASSERT(consumerItems == producerItems * subscribers);
+    return producerItems;
+  }
+
+  static void print(const RunResult&) {}
+};
+
+template<template<typename> class B> void benchmarkBroadcastQueue(const String& name)
+{
+  if(!isSelected(name))
+    return;
+  static const int subscriberCounts[] = {1, 2, 4, 8};
+  for(List<ThreadConfig>::Iterator i = options.threads.begin(), end = options.threads.end(); i != end; ++i)
+    for(usize k = 0; k < sizeof(subscriberCounts) / sizeof(*subscriberCounts); ++k)
+      benchmarkPayloads<BroadcastWorkload, B>(name, i->producers, subscriberCounts[k], noAffinity);
+}
+
+// the lossless baseline for the overload benchmark, its producers wait while the ring is full
+template<typename T> class LosslessQueue : public LockFreeQueueCpp11<T>
+{
+public:
+  explicit LosslessQueue(usize capacity) : LockFreeQueueCpp11<T>(capacity) {}
+
+  usize drops() const {return 0;}
+};
+
+template<typename T> using OverwriteLockFreeQueueCpp11 = OverwriteQueue<T, LockFreeQueueCpp11<T> >;
+
+// conflates the items on 64 keys taken from their low bits
+template<typename T> class ConflatingItems
+{
+public:
+  explicit ConflatingItems(usize) : queue(64) {}
+
+  usize size() const {return queue.size();}
+  usize drops() const {return queue.drops();}
+
+  bool push(const T& item) {return queue.push((usize)item % 64, item);}
+
+  bool pop(T& result)
+  {
+    usize key;
+    return queue.pop(key, result);
+  }
+
+private:
+  ConflatingQueue<T> queue;
+};
+
+// the consumers spin for this many rounds per item, so that they cannot keep up with the producers
+static const uint32 overloadWork = 512;
+static volatile usize overloadSink;
+
+template<class Q, typename T> uint overloadConsumerThread(void* param)
+{
+  BenchmarkContext<Q>* context = (BenchmarkContext<Q>*)param;
+  Q* queue = context->queue;
+  T val;
+  usize items = 0;
+  for(;;)
+  {
+    uint64 startTime = CycleClock::now();
+    bool popped;
+    while(!(popped = queue->pop(val)) && Atomic::load(runningProducers))
+    {
+      Thread::yield();
+      startTime = CycleClock::now();
     }
+    if(!popped && !queue->pop(val))
+      break;
+    uint64 now = CycleClock::now();
+    context->latency.pop.record(now - startTime);
+    context->latency.endToEnd.record(elapsedTicks(val, now));
+    usize value = (usize)val;
+    for(uint32 i = 0; i < overloadWork; ++i)
+      value = value * 6364136223846793005ULL + 1442695040888963407ULL;
+    overloadSink = value;
+    ++items;
+  }
+  Atomic::fetchAndAdd(consumerItems, items);
+  return 0;
+}
+
+// the throughput is the number of items delivered per second, the items that were dropped are not checked by their sum
+template<class Q, typename T> struct OverloadWorkload
+{
+  typedef Q Queue;
+
+  static Q* create(int) {return new Q(options.capacity);}
+  static uint producer(void* param) {return producerThread<Q, T>(param);}
+  static uint consumer(void* param) {return overloadConsumerThread<Q, T>(param);}
+
+  static usize finish(Q& queue, int, RunResult& result)
+  {
     ASSERT(queue.size() == 0);
-    ASSERT(producerSum == consumerSum);
+    ASSERT(consumerItems + queue.drops() == producerItems);
+    result.dropRate = producerItems ? (double)queue.drops() / (double)producerItems : 0.;
+    return consumerItems;
+  }
+
+  static void print(const RunResult& result) {Console::printf(_T("  dropped: %.1f%% of the pushed items\n"), result.dropRate * 100.);}
+};
+
+template<typename T> using LockFreeQueueCpp11Spin = LockFreeQueueCpp11<T, Producers::Multi, Consumers::Multi, HeapAllocator, Layouts::Packed, Backoffs::Spin>;
+template<typename T> using LockFreeQueueCpp11Yield = LockFreeQueueCpp11<T, Producers::Multi, Consumers::Multi, HeapAllocator, Layouts::Packed, Backoffs::Yield>;
+template<typename T> using LockFreeQueueCpp11Sleep = LockFreeQueueCpp11<T, Producers::Multi, Consumers::Multi, HeapAllocator, Layouts::Packed, Backoffs::Sleep>;
+template<typename T> using LockFreeQueueCpp11Park = LockFreeQueueCpp11<T, Producers::Multi, Consumers::Multi, HeapAllocator, Layouts::Packed, Backoffs::Park>;
+template<typename T> using MpmcBoundedQueueSpin = mpmc_bounded_queue<T, Backoffs::Spin>;
+template<typename T> using MpmcBoundedQueueYield = mpmc_bounded_queue<T, Backoffs::Yield>;
+template<typename T> using MpmcBoundedQueueSleep = mpmc_bounded_queue<T, Backoffs::Sleep>;
+template<typename T> using MpmcBoundedQueuePark = mpmc_bounded_queue<T, Backoffs::Park>;
+
+// the threads wait in the timed push and pop of the queue instead of yielding between attempts
+static const int backoffTimeout = 10;
+
+template<class Q, typename T> uint backoffProducerThread(void* param)
+{
+  BenchmarkContext<Q>* context = (BenchmarkContext<Q>*)param;
+  Q* queue = context->queue;
+  usize sum = 0;
+  usize items = 0;
+  while(!Atomic::load(benchmarkStopped))
+  {
+    uint64 startTime = CycleClock::now();
+    T item((usize)startTime);
+    if(!queue->try_push_for(item, std::chrono::milliseconds(backoffTimeout)))
+      continue;
+    context->latency.push.record(CycleClock::now() - startTime);
+    sum += (usize)item;
+    ++items;
+  }
+  Atomic::fetchAndAdd(producerSum, sum);
+  Atomic::fetchAndAdd(producerItems, items);
+  Atomic::decrement(runningProducers);
+  return 0;
+}
+
+template<class Q, typename T> uint backoffConsumerThread(void* param)
+{
+  BenchmarkContext<Q>* context = (BenchmarkContext<Q>*)param;
+  Q* queue = context->queue;
+  T val;
+  usize sum = 0;
+  usize items = 0;
+  for(;;)
+  {
+    uint64 startTime = CycleClock::now();
+    bool popped;
+    while(!(popped = queue->try_pop_for(val, std::chrono::milliseconds(backoffTimeout))) && Atomic::load(runningProducers))
+      startTime = CycleClock::now();
+    if(!popped && !queue->pop(val))
+      break;
+    uint64 now = CycleClock::now();
+    context->latency.pop.record(now - startTime);
+    context->latency.endToEnd.record(elapsedTicks(val, now));
+    sum += (usize)val;
+    ++items;
+  }
+  Atomic::fetchAndAdd(consumerSum, sum);
+  Atomic::fetchAndAdd(consumerItems, items);
+  return 0;
+}
+
+// reports the cpu time per second of wall time, which the backoff policies trade for latency
+template<class Q, typename T> struct BackoffWorkload : QueueWorkload<Q, T>
+{
+  static uint producer(void* param) {return backoffProducerThread<Q, T>(param);}
+  static uint consumer(void* param) {return backoffConsumerThread<Q, T>(param);}
+
+  static void print(const RunResult& result)
+  {
+    Console::printf(_T("  cpu: %.2f cores, %.0f ns per item\n"), result.cpuLoad, result.opsPerSecond > 0. ? result.cpuLoad * 1000000000. / result.opsPerSecond : 0.);
+  }
+};
+
+#ifndef _WIN32
+enum Transport
+{
+  sharedMemoryTransport,
+  socketTransport,
+};
+
+struct ProcessResult
+{
+  usize items;
+  usize sum;
+  LatencyHistogram pop;
+  LatencyHistogram endToEnd;
+
+  ProcessResult() : items(0), sum(0) {}
+};
+
+static bool readAll(int fd, void* data, usize size)
+{
+  for(char* position = (char*)data; size;)
+  {
+    ssize_t count = read(fd, position, size);
+    if(count <= 0)
+      return false;
+    position += count;
+    size -= (usize)count;
+  }
+  return true;
+}
+
+static bool writeAll(int fd, const void* data, usize size)
+{
+  for(const char* position = (const char*)data; size;)
+  {
+    ssize_t count = write(fd, position, size);
+    if(count <= 0)
+      return false;
+    position += count;
+    size -= (usize)count;
+  }
+  return true;
+}
+
+template<typename T> void sharedMemoryConsumerProcess(const String& name, int countFd, ProcessResult& result)
+{
+  SharedMemoryQueue<T> queue;
+  if(!queue.open(name))
+    return;
+  usize totalItems = (usize)-1;
+  T item;
+  for(;;)
+  {
+    uint64 startTime = CycleClock::now();
+    if(queue.pop(item))
+    {
+      uint64 now = CycleClock::now();
+      result.pop.record(now - startTime);
+      result.endToEnd.record(elapsedTicks(item, now));
+      result.sum += (usize)item;
+      ++result.items;
+      continue;
+    }
+    if(result.items == totalItems)
+      break;
+    if(totalItems == (usize)-1)
+    {
+      // the producer announces how many items it pushed once it is done
+      struct pollfd descriptor = {countFd, POLLIN, 0};
+      if(poll(&descriptor, 1, 0) == 1 && !readAll(countFd, &totalItems, sizeof(totalItems)))
+        break;
+    }
+    Thread::yield();
+  }
+}
+
+template<typename T> void socketConsumerProcess(int socket, ProcessResult& result)
+{
+  // a blocking read includes the time spent waiting for data, so only end-to-end latency is recorded
+  char buffer[sizeof(T) * testBulkItems];
+  usize size = 0;
+  T item;
+  for(;;)
+  {
+    ssize_t count = read(socket, buffer + size, sizeof(buffer) - size);
+    if(count <= 0)
+      break;
+    uint64 now = CycleClock::now();
+    size += (usize)count;
+    usize offset = 0;
+    for(; size - offset >= sizeof(T); offset += sizeof(T))
+    {
+      std::memcpy(&item, buffer + offset, sizeof(T));
+      result.endToEnd.record(elapsedTicks(item, now));
+      result.sum += (usize)item;
+      ++result.items;
+    }
+    size -= offset;
+    std::memmove(buffer, buffer + offset, size);
   }
+}
+
+template<typename T> double runProcessBenchmark(Transport transport, LatencyHistograms* latency)
+{
+  String name;
+  name.printf(_T("/LockFreeQueue.%d"), (int)getpid());
+  SharedMemoryQueue<T> queue;
+  int sockets[2] = {-1, -1};
+  int countPipe[2];
+  int resultPipe[2];
+  if(transport == socketTransport)
+    ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0);
+  else
+    ASSERT(queue.create(name, options.capacity));
+  ASSERT(pipe(countPipe) == 0);
+  ASSERT(pipe(resultPipe) == 0);
+
+  pid_t pid = fork();
+  ASSERT(pid != -1);
+  if(pid == 0)
+  {
+    ::close(countPipe[1]);
+    ::close(resultPipe[0]);
+    ProcessResult* result = new ProcessResult;
+    if(transport == socketTransport)
+    {
+      ::close(sockets[0]);
+      socketConsumerProcess<T>(sockets[1], *result);
+    }
+    else
+    {
+      // attach by name like an unrelated process would instead of using the inherited mapping
+      queue.close();
+      sharedMemoryConsumerProcess<T>(name, countPipe[0], *result);
+    }
+    writeAll(resultPipe[1], result, sizeof(*result));
+    _exit(0);
+  }
+  ::close(countPipe[0]);
+  ::close(resultPipe[1]);
+  if(transport == socketTransport)
+    ::close(sockets[1]);
+
+  usize sum = 0;
+  usize items = 0;
+  int64 microStartTime = Time::microTicks();
+  int64 microEndTime = microStartTime + options.duration * 1000;
+  for(; (items & 0xff) || Time::microTicks() < microEndTime; ++items)
+  {
+    uint64 startTime;
+    T item;
+    if(transport == socketTransport)
+    {
+      startTime = CycleClock::now();
+      item = T((usize)startTime);
+      ASSERT(writeAll(sockets[0], &item, sizeof(T)));
+    }
+    else
+      for(;;)
+      {
+        startTime = CycleClock::now();
+        item = T((usize)startTime);
+        if(queue.push(item))
+          break;
+        Thread::yield();
+      }
+    if(latency)
+      latency->push.record(CycleClock::now() - startTime);
+    sum += (usize)item;
+  }
+  if(transport == socketTransport)
+    ::close(sockets[0]);
+  writeAll(countPipe[1], &items, sizeof(items));
+
+  ProcessResult* result = new ProcessResult;
+  bool received = readAll(resultPipe[0], result, sizeof(*result));
   int64 microDuration = Time::microTicks() - microStartTime;
-  Console::printf(_T("%lld ms, maxPush: %lld microseconds, maxPop: %lld microseconds\n"), microDuration / 1000, maxPushDuration, maxPopDuration);
+  waitpid(pid, 0, 0);
+  ::close(countPipe[1]);
+  ::close(resultPipe[0]);
+  if(transport == sharedMemoryTransport)
+    SharedMemoryQueue<T>::unlink(name);
+
+  ASSERT(received);
+  ASSERT(result->items == items);
+  ASSERT(result->sum == sum);
+  if(latency)
+  {
+    latency->pop.merge(result->pop);
+    latency->endToEnd.merge(result->endToEnd);
+  }
+  delete result;
+  return items * 1000000. / microDuration;
+}
+
+template<typename T> void benchmarkProcesses(const String& name, Transport transport, usize payload)
+{
+  Result& result = results.append(Result());
+  result.queue = name;
+  result.payload = payload;
+  result.producers = 1;
+  result.consumers = 1;
+  result.topology = noAffinity;
+  result.memoryNode = -1;
+  result.capacity = transport == sharedMemoryTransport ? options.capacity : 0;
+  result.ringBytes = 0;
+  result.runs = options.repeats;
+
+  Console::printf(_T("Benchmarking %s (1x1, %d bytes)... \n"), (const tchar*)name, (int)payload);
+
+  for(int i = 0; i < options.warmups; ++i)
+    runProcessBenchmark<T>(transport, 0);
+
+  LatencyHistograms* latency = new LatencyHistograms;
+  double sum = 0., squareSum = 0.;
+  for(int i = 0; i < options.repeats; ++i)
+  {
+    double opsPerSecond = runProcessBenchmark<T>(transport, latency);
+    sum += opsPerSecond;
+    squareSum += opsPerSecond * opsPerSecond;
+  }
+  summarizeResult(result, sum, squareSum, *latency);
+  delete latency;
+}
+
+static void benchmarkProcessQueue(const String& name, Transport transport)
+{
+  if(!isSelected(name))
+    return;
+  for(List<usize>::Iterator j = options.payloads.begin(), end = options.payloads.end(); j != end; ++j)
+    switch(*j)
+    {
+    case 4: benchmarkProcesses<int>(name, transport, *j); break;
+    case 8: benchmarkProcesses<int64>(name, transport, *j); break;
+    case 16: benchmarkProcesses<Payload<16> >(name, transport, *j); break;
+    case 64: benchmarkProcesses<Payload<64> >(name, transport, *j); break;
+    case 256: benchmarkProcesses<Payload<256> >(name, transport, *j); break;
+    case 1024: benchmarkProcesses<Payload<1024> >(name, transport, *j); break;
+    case 4096: benchmarkProcesses<Payload<4096> >(name, transport, *j); break;
+    }
+}
+#endif
+
+static void benchmarkQueues()
+{
+  benchmarkQueue<QueueWorkload, LockFreeQueueCpp11MultiMulti>("LockFreeQueueCpp11");
+  benchmarkQueue<BulkQueueWorkload, LockFreeQueueCpp11MultiMulti>("LockFreeQueueCpp11 (bulk)");
+  benchmarkQueue<QueueWorkload, LockFreeQueueCpp11InPlace>("LockFreeQueueCpp11 (in place)");
+  benchmarkQueue<QueueWorkload, LockFreeQueueCpp11MultiSingle>("LockFreeQueueCpp11<Multi, Single>", 0, 1);
+  benchmarkQueue<QueueWorkload, LockFreeQueueCpp11SingleMulti>("LockFreeQueueCpp11<Single, Multi>", 1, 0);
+  benchmarkQueue<QueueWorkload, LockFreeQueueCpp11SingleSingle>("LockFreeQueueCpp11<Single, Single>", 1, 1);
+  benchmarkQueue<QueueWorkload, LockFreeQueueCpp11Padded>("LockFreeQueueCpp11<Padded>");
+  benchmarkQueue<QueueWorkload, LockFreeQueueCpp11Remapped>("LockFreeQueueCpp11<Remapped>");
+  benchmarkQueue<QueueWorkload, LockFreeQueueCompactSize>("LockFreeQueueCompact");
+  benchmarkQueue<BulkQueueWorkload, LockFreeQueueCompactSize>("LockFreeQueueCompact (bulk)");
+  benchmarkQueue<QueueWorkload, LockFreeQueueCompact32>("LockFreeQueueCompact<uint32_t>");
+  benchmarkQueue<QueueWorkload, LockFreeByteQueueRecords>("LockFreeByteQueue");
+  benchmarkQueue<QueueWorkload, MpmcBoundedQueue>("mpmc_bounded_queue");
+  benchmarkQueue<QueueWorkload, LockFreeQueueScq>("LockFreeQueueScq");
+  benchmarkQueue<QueueWorkload, LockFreeQueuePacked>("LockFreeQueue");
+  benchmarkQueue<QueueWorkload, LockFreeQueuePadded>("LockFreeQueue<Padded>");
+  benchmarkQueue<QueueWorkload, LockFreeQueueRemapped>("LockFreeQueue<Remapped>");
+  benchmarkQueue<QueueWorkload, LockFreeQueueSlow1>("LockFreeQueueSlow1");
+  benchmarkQueue<QueueWorkload, LockFreeQueueSlow2>("LockFreeQueueSlow2");
+  benchmarkQueue<QueueWorkload, LockFreeQueueSlow3>("LockFreeQueueSlow3");
+  benchmarkQueue<QueueWorkload, MutexLockQueue>("MutexLockQueue");
+  benchmarkQueue<QueueWorkload, SpinLockQueue>("SpinLockQueue");
+  benchmarkQueue<QueueWorkload, LockFreeLifoQueuePlain>("LockFreeLifoQueue");
+  benchmarkQueue<QueueWorkload, LockFreeLifoQueueElimination>("LockFreeLifoQueue (8x64 elimination)");
+  benchmarkQueue<QueueWorkload, LockFreeLifoQueueElimination16>("LockFreeLifoQueue (16x256 elimination)");
+  benchmarkQueue<QueueWorkload, LockFreeSpscQueueNuma>("LockFreeSpscQueue", 1, 1);
+  benchmarkQueue<BulkQueueWorkload, LockFreeSpscQueueNuma>("LockFreeSpscQueue (bulk)", 1, 1);
+  benchmarkQueue<QueueWorkload, LockFreeUnboundedQueue>("LockFreeUnboundedQueue");
+  benchmarkQueue<QueueWorkload, MallocPointerQueue>("LockFreeQueueCpp11<T*> (malloc)");
+  benchmarkQueue<QueueWorkload, PoolPointerQueue>("LockFreeQueueCpp11<T*> (LockFreeObjectPool)");
+#if __cplusplus >= 201703L
+  benchmarkQueue<QueueWorkload, PmrPointerQueue>("LockFreeQueueCpp11<T*> (std::pmr)");
+#endif
+  benchmarkQueue<QueueWorkload, PriorityLevelsStrict>("PriorityLockFreeQueue<4>");
+  benchmarkQueue<QueueWorkload, PriorityLevelsAged>("PriorityLockFreeQueue<4> (starvation limit 16)");
+  benchmarkQueue<QueueWorkload, ProbingLevels>("LockFreeQueueCpp11 x4 (probing)");
+  benchmarkQueue<QueueWorkload, CountedLockFreeQueueCpp11>("CountedQueue<LockFreeQueueCpp11>");
+  benchmarkQueue<QueueWorkload, ShardedQueue1>("ShardedQueue<LockFreeQueueCpp11> (1 lane)");
+  benchmarkQueue<QueueWorkload, ShardedQueue2>("ShardedQueue<LockFreeQueueCpp11> (2 lanes)");
+  benchmarkQueue<QueueWorkload, ShardedQueue4>("ShardedQueue<LockFreeQueueCpp11> (4 lanes)");
+  benchmarkQueue<QueueWorkload, ShardedQueue8>("ShardedQueue<LockFreeQueueCpp11> (8 lanes)");
+  benchmarkQueue<QueueWorkload, ShardedMpmcQueue4>("ShardedQueue<mpmc_bounded_queue> (4 lanes)");
+  benchmarkQueue<QueueWorkload, BlockingLockFreeQueueCpp11>("BlockingQueue<LockFreeQueueCpp11>");
+  benchmarkQueue<QueueWorkload, BlockingLockFreeQueue>("BlockingQueue<LockFreeQueue>");
+  benchmarkBroadcastQueue<BroadcastSubscribers>("BroadcastQueue");
+  benchmarkBroadcastQueue<FanOutQueues>("LockFreeQueueCpp11 (fan-out)");
+  benchmarkQueue<OverloadWorkload, LosslessQueue>("LockFreeQueueCpp11 (overload)");
+  benchmarkQueue<OverloadWorkload, OverwriteLockFreeQueueCpp11>("OverwriteQueue<LockFreeQueueCpp11> (overload)");
+  benchmarkQueue<OverloadWorkload, ConflatingItems>("ConflatingQueue (overload)");
+  benchmarkQueue<BackoffWorkload, LockFreeQueueCpp11Spin>("LockFreeQueueCpp11 (spin backoff)");
+  benchmarkQueue<BackoffWorkload, LockFreeQueueCpp11Yield>("LockFreeQueueCpp11 (yield backoff)");
+  benchmarkQueue<BackoffWorkload, LockFreeQueueCpp11Sleep>("LockFreeQueueCpp11 (sleep backoff)");
+  benchmarkQueue<BackoffWorkload, LockFreeQueueCpp11Park>("LockFreeQueueCpp11 (park backoff)");
+  benchmarkQueue<BackoffWorkload, MpmcBoundedQueueSpin>("mpmc_bounded_queue (spin backoff)");
+  benchmarkQueue<BackoffWorkload, MpmcBoundedQueueYield>("mpmc_bounded_queue (yield backoff)");
+  benchmarkQueue<BackoffWorkload, MpmcBoundedQueueSleep>("mpmc_bounded_queue (sleep backoff)");
+  benchmarkQueue<BackoffWorkload, MpmcBoundedQueuePark>("mpmc_bounded_queue (park backoff)");
+#ifndef _WIN32
+  benchmarkProcessQueue("SharedMemoryQueue (2 processes)", sharedMemoryTransport);
+  benchmarkProcessQueue("UNIX socket (2 processes)", socketTransport);
+#endif
+}
+
+static bool writeCsv(const String& path)
+{
+  File file;
+  if(!file.open(path, File::writeFlag))
+    return false;
+  String line(_T("queue,payload,producers,consumers,topology,memory_node,capacity,ring_bytes,runs,mean_ops_per_sec,stddev_ops_per_sec,cpu_load,drop_rate"));
+  const tchar* latencyNames[] = {_T("push"), _T("pop"), _T("end_to_end")};
+  String column;
+  for(usize i = 0; i < sizeof(latencyNames) / sizeof(*latencyNames); ++i)
+  {
+    column.printf(_T(",%s_p50_ns,%s_p99_ns,%s_p99_9_ns,%s_p99_99_ns,%s_max_ns"), latencyNames[i], latencyNames[i], latencyNames[i], latencyNames[i], latencyNames[i]);
+    line += column;
+  }
+  line += _T("\n");
+  if(!file.write(line))
+    return false;
+  for(List<Result>::Iterator i = results.begin(), end = results.end(); i != end; ++i)
+  {
+    line.printf(_T("\"%s\",%d,%d,%d,%s,%d,%d,%llu,%d,%.0f,%.0f,%.2f,%.6f"), (const tchar*)i->queue, (int)i->payload, i->producers, i->consumers, topologyNames[i->topology], i->memoryNode, (int)i->capacity, (uint64)i->ringBytes, i->runs,
+      i->meanOpsPerSecond, i->stddevOpsPerSecond, i->cpuLoad, i->dropRate);
+    const Latency* latencies[] = {&i->push, &i->pop, &i->endToEnd};
+    for(usize j = 0; j < sizeof(latencies) / sizeof(*latencies); ++j)
+    {
+      column.printf(_T(",%.0f,%.0f,%.0f,%.0f,%.0f"), latencies[j]->p50, latencies[j]->p99, latencies[j]->p999, latencies[j]->p9999, latencies[j]->max);
+      line += column;
+    }
+    line += _T("\n");
+    if(!file.write(line))
+      return false;
+  }
+  return true;
+}
+
+static String latencyJson(const Latency& latency)
+{
+  String json;
+  json.printf(_T("{\"p50\": %.0f, \"p99\": %.0f, \"p99.9\": %.0f, \"p99.99\": %.0f, \"max\": %.0f}"), latency.p50, latency.p99, latency.p999, latency.p9999, latency.max);
+  return json;
+}
+
+static bool writeJson(const String& path)
+{
+  File file;
+  if(!file.open(path, File::writeFlag))
+    return false;
+  if(!file.write(String(_T("[\n"))))
+    return false;
+  String line;
+  for(List<Result>::Iterator i = results.begin(), end = results.end(); i != end;)
+  {
+    const Result& result = *i;
+    line.printf(_T("  {\"queue\": \"%s\", \"payload\": %d, \"producers\": %d, \"consumers\": %d, \"topology\": \"%s\", \"memoryNode\": %d, \"capacity\": %d, \"ringBytes\": %llu, \"runs\": %d, \"meanOpsPerSecond\": %.0f, \"stddevOpsPerSecond\": %.0f, \"cpuLoad\": %.2f, \"dropRate\": %.6f, \"pushNanoseconds\": %s, \"popNanoseconds\": %s, \"endToEndNanoseconds\": %s}%s\n"),
+      (const tchar*)result.queue, (int)result.payload, result.producers, result.consumers, topologyNames[result.topology], result.memoryNode, (int)result.capacity, (uint64)result.ringBytes, result.runs,
+      result.meanOpsPerSecond, result.stddevOpsPerSecond, result.cpuLoad, result.dropRate, (const tchar*)latencyJson(result.push), (const tchar*)latencyJson(result.pop), (const tchar*)latencyJson(result.endToEnd),
+      ++i == end ? _T("") : _T(","));
+    if(!file.write(line))
+      return false;
+  }
+  return file.write(String(_T("]\n")));
+}
+
+static bool parseList(const String& argument, List<String>& items)
+{
+  for(const tchar* start = argument, * end;; start = end + 1)
+  {
+    for(end = start; *end && *end != _T(','); ++end);
+    if(end == start)
+      return false;
+    items.append(String(start, end - start));
+    if(!*end)
+      return true;
+  }
+}
+
+static bool parseThreadConfig(const String& argument, ThreadConfig& config)
+{
+  tchar* end;
+  config.producers = (int)std::strtol(argument, &end, 10);
+  if(*end != _T('x'))
+    return false;
+  config.consumers = (int)std::strtol(end + 1, &end, 10);
+  return !*end && config.producers > 0 && config.consumers > 0;
+}
+
+static int usage(const char* program)
+{
+  Console::errorf(_T("Usage: %s [options]\n\
+  -t, --threads <PxC,...>   producer x consumer thread counts (default: 8x8)\n\
+  -s, --capacity <n>        queue capacity (default: 100)\n\
+  -b, --payload <bytes,...> element sizes: 4, 8, 16, 64, 256, 1024 or 4096 (default: 4)\n\
+  -d, --duration <ms>       duration of each run (default: 1000)\n\
+  -q, --queues <name,...>   queue implementations to benchmark (default: all)\n\
+  -a, --affinity <mode,...> thread placement: none, smt, socket or cross (default: none)\n\
+  -m, --memory-node <n>     numa node of the ring buffer (default: first touch)\n\
+  -w, --warmup <n>          warm-up runs (default: 1)\n\
+  -r, --repeat <n>          measured runs (default: 3)\n\
+  -n, --no-test             skip the functional tests\n\
+  -l, --wake                run the wake latency comparison\n\
+  -o, --cold-start          measure the first lap through a new ring with each allocator\n\
+  -k, --scheduler           run unbalanced task graphs on P+C workers with work stealing and with a shared ring\n\
+  -c, --csv <file>          write results as CSV\n\
+  -j, --json <file>         write results as JSON\n"), program);
+  return -1;
 }
 
 int main(int argc, char* argv[])
 {
-  for(int i = 0; i < 3; ++i)
+  options.memoryNode = -1;
+  options.capacity = 100;
+  options.duration = 1000;
+  options.warmups = 1;
+  options.repeats = 3;
+  options.test = true;
+  options.wake = false;
+  options.coldStart = false;
+  options.scheduler = false;
+  {
+    Process::Option processOptions[] = {
+      {'t', "threads", Process::argumentFlag},
+      {'s', "capacity", Process::argumentFlag},
+      {'b', "payload", Process::argumentFlag},
+      {'d', "duration", Process::argumentFlag},
+      {'q', "queues", Process::argumentFlag},
+      {'a', "affinity", Process::argumentFlag},
+      {'m', "memory-node", Process::argumentFlag},
+      {'w', "warmup", Process::argumentFlag},
+      {'r', "repeat", Process::argumentFlag},
+      {'n', "no-test", Process::optionFlag},
+      {'l', "wake", Process::optionFlag},
+      {'o', "cold-start", Process::optionFlag},
+      {'k', "scheduler", Process::optionFlag},
+      {'c', "csv", Process::argumentFlag},
+      {'j', "json", Process::argumentFlag},
+      {'h', "help", Process::optionFlag},
+    };
+    Process::Arguments arguments(argc, argv, processOptions);
+    int character;
+    String argument;
+    List<String> items;
+    while(arguments.read(character, argument))
+      switch(character)
+      {
+      case 't':
+        items.clear();
+        if(!parseList(argument, items))
+          return usage(argv[0]);
+        for(List<String>::Iterator i = items.begin(), end = items.end(); i != end; ++i)
+          if(!parseThreadConfig(*i, options.threads.append(ThreadConfig())))
+            return usage(argv[0]);
+        break;
+      case 's':
+        options.capacity = (usize)std::strtoul(argument, 0, 10);
+        break;
+      case 'b':
+        items.clear();
+        if(!parseList(argument, items))
+          return usage(argv[0]);
+        for(List<String>::Iterator i = items.begin(), end = items.end(); i != end; ++i)
+        {
+          usize payload = (usize)std::strtoul(*i, 0, 10);
+          if(payload != 4 && payload != 8 && payload != 16 && payload != 64 && payload != 256 && payload != 1024 && payload != 4096)
+            return usage(argv[0]);
+          options.payloads.append(payload);
+        }
+        break;
+      case 'd':
+        options.duration = std::strtol(argument, 0, 10);
+        break;
+      case 'q':
+        if(!parseList(argument, options.queues))
+          return usage(argv[0]);
+        break;
+      case 'a':
+        items.clear();
+        if(!parseList(argument, items))
+          return usage(argv[0]);
+        for(List<String>::Iterator i = items.begin(), end = items.end(); i != end; ++i)
+        {
+          int topology = 0;
+          while(topology < numOfTopologies && *i != String(topologyNames[topology]))
+            ++topology;
+          if(topology == numOfTopologies)
+            return usage(argv[0]);
+          options.topologies.append((Topology)topology);
+        }
+        break;
+      case 'm':
+        options.memoryNode = (int)std::strtol(argument, 0, 10);
+        break;
+      case 'w':
+        options.warmups = (int)std::strtol(argument, 0, 10);
+        break;
+      case 'r':
+        options.repeats = (int)std::strtol(argument, 0, 10);
+        break;
+      case 'n':
+        options.test = false;
+        break;
+      case 'l':
+        options.wake = true;
+        break;
+      case 'o':
+        options.coldStart = true;
+        break;
+      case 'k':
+        options.scheduler = true;
+        break;
+      case 'c':
+        options.csvFile = argument;
+        break;
+      case 'j':
+        options.jsonFile = argument;
+        break;
+      case '?':
+        Console::errorf(_T("Unknown option: %s.\n"), (const tchar*)argument);
+        return -1;
+      case ':':
+        Console::errorf(_T("Option %s required an argument.\n"), (const tchar*)argument);
+        return -1;
+      default:
+        return usage(argv[0]);
+      }
+  }
+  if(options.threads.isEmpty())
   {
-    Console::printf(_T("--- Run %d ---\n"), i);
-    testQueue<LockFreeQueueCpp11<int> >("LockFreeQueueCpp11");
-    testQueue<mpmc_bounded_queue<int> >("mpmc_bounded_queue");
-    testQueue<LockFreeQueue<int> >("LockFreeQueue");
-    testQueue<LockFreeQueueSlow1<int> >("LockFreeQueueSlow1");
-    testQueue<LockFreeQueueSlow2<int> >("LockFreeQueueSlow2");
-    testQueue<LockFreeQueueSlow3<int> >("LockFreeQueueSlow3");
-    testQueue<MutexLockQueue<int> >("MutexLockQueue");
-    testQueue<SpinLockQueue<int> >("SpinLockQueue");
-    testQueue<LockFreeLifoQueue<int> >("LockFreeLifoQueue", true);
+    ThreadConfig& config = options.threads.append(ThreadConfig());
+    config.producers = 8;
+    config.consumers = 8;
   }
+  if(options.payloads.isEmpty())
+    options.payloads.append(4);
+  if(options.topologies.isEmpty())
+    options.topologies.append(noAffinity);
+  if(!options.capacity || options.repeats < 1 || options.warmups < 0 || options.duration < 0)
+    return usage(argv[0]);
+
+  if(options.test)
+    test();
+  if(options.wake)
+    testWake();
+  Console::printf(_T("Calibrated %.3f ns per tick\n"), CycleClock::nanosecondsPerTick());
+  if(options.coldStart)
+    benchmarkColdStarts();
+  if(options.scheduler)
+    benchmarkSchedulers();
+  benchmarkQueues();
 
+  if(!options.csvFile.isEmpty() && !writeCsv(options.csvFile))
+  {
+    Console::errorf(_T("Could not write %s.\n"), (const tchar*)options.csvFile);
+    return -1;
+  }
+  if(!options.jsonFile.isEmpty() && !writeJson(options.jsonFile))
+  {
+    Console::errorf(_T("Could not write %s.\n"), (const tchar*)options.jsonFile);
+    return -1;
+  }
   return 0;
 }
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+#include "Allocator.h"
+
+// a bounded work-stealing deque based on [Chase and Lev, 2005] with the memory orders of [Le et al., 2013]
+// push and pop may only be called by the owning thread, steal by any thread
+template <typename T, class A = HeapAllocator> class WorkStealingDeque
+{
+  // a thief copies an element before it knows whether it won it, so the owner may overwrite the slot concurrently
+  static_assert(std::is_trivially_copyable<T>::value, "elements must be trivially copyable");
+
+public:
+  explicit WorkStealingDeque(size_t capacity, const A& allocator = A()) : _allocator(allocator)
+  {
+    _capacityMask = capacity - 1;
+    for(size_t i = 1; i <= sizeof(void*) * 4; i <<= 1)
+      _capacityMask |= _capacityMask >> i;
+    _capacity = _capacityMask + 1;
+
+    _queue = (T*)_allocator.allocate(sizeof(T) * _capacity);
+
+    _top.store(0, std::memory_order_relaxed);
+    _bottom.store(0, std::memory_order_relaxed);
+  }
+
+  ~WorkStealingDeque()
+  {
+    _allocator.deallocate(_queue, sizeof(T) * _capacity);
+  }
+
+  size_t capacity() const {return _capacity;}
+
+  size_t size() const
+  {
+    ptrdiff_t top = _top.load(std::memory_order_acquire);
+    ptrdiff_t size = _bottom.load(std::memory_order_relaxed) - top;
+    return size > 0 ? (size_t)size : 0;
+  }
+
+  size_t approx_size() const
+  {
+    ptrdiff_t top = _top.load(std::memory_order_relaxed);
+    ptrdiff_t size = _bottom.load(std::memory_order_relaxed) - top;
+    return size <= 0 ? 0 : (size_t)size > _capacity ? _capacity : (size_t)size;
+  }
+
+  bool push(const T& data)
+  {
+    ptrdiff_t bottom = _bottom.load(std::memory_order_relaxed);
+    ptrdiff_t top = _top.load(std::memory_order_acquire);
+    if(bottom - top >= (ptrdiff_t)_capacity)
+      return false;
+    _queue[bottom & _capacityMask] = data;
+    std::atomic_thread_fence(std::memory_order_release);
+    _bottom.store(bottom + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  bool pop(T& result)
+  {
+    ptrdiff_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+    _bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    ptrdiff_t top = _top.load(std::memory_order_relaxed);
+    if(top > bottom)
+    {
+      _bottom.store(bottom + 1, std::memory_order_relaxed);
+      return false;
+    }
+    result = _queue[bottom & _capacityMask];
+    if(top < bottom)
+      return true;
+    // the last element, race the thieves for it
+    bool won = _top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    _bottom.store(bottom + 1, std::memory_order_relaxed);
+    return won;
+  }
+
+  // takes the oldest element, fails when the deque is empty or another thread took the element first
+  bool steal(T& result)
+  {
+    ptrdiff_t top = _top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    ptrdiff_t bottom = _bottom.load(std::memory_order_acquire);
+    if(top >= bottom)
+      return false;
+    result = _queue[top & _capacityMask];
+    return _top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+  }
+
+private:
+  size_t _capacityMask;
+  T* _queue;
+  size_t _capacity;
+  A _allocator;
+  char cacheLinePad1[64];
+  std::atomic<ptrdiff_t> _top;
+  char cacheLinePad2[64];
+  std::atomic<ptrdiff_t> _bottom;
+  char cacheLinePad3[64];
+};
@@ -18,8 +18,14 @@
 
 #include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <new>
+#include <utility>
 
-template<typename T>
+#include "Backoff.h"
+
+template<typename T, class B = Backoffs::Yield>
 class mpmc_bounded_queue
 {
 private:
@@ -32,7 +38,7 @@ private:
   }
 public:
   mpmc_bounded_queue(size_t buffer_size)
-    : buffer_(new cell_t [nextPowerOfTwo(buffer_size)])
+    : buffer_((cell_t*)::operator new(sizeof(cell_t) * nextPowerOfTwo(buffer_size)))
     , buffer_mask_(nextPowerOfTwo(buffer_size) - 1)
   {
     buffer_size = buffer_mask_ + 1;
@@ -44,9 +50,12 @@ public:
     dequeue_pos_.store(0, std::memory_order_relaxed);
   }
 
+  // the cells are raw storage, only the elements between the dequeue and the enqueue position are constructed
   ~mpmc_bounded_queue()
   {
-    delete [] buffer_;
+    for (size_t pos = dequeue_pos_.load(std::memory_order_relaxed), end = enqueue_pos_.load(std::memory_order_relaxed); pos != end; ++pos)
+      buffer_[pos & buffer_mask_].data_.~T();
+    ::operator delete(buffer_);
   }
 
   size_t size() const
@@ -55,12 +64,66 @@ public:
     return enqueue_pos_.load(std::memory_order_relaxed) - head;
   }
 
+  size_t approx_size() const
+  {
+    size_t head = dequeue_pos_.load(std::memory_order_relaxed);
+    ptrdiff_t size = (ptrdiff_t)(enqueue_pos_.load(std::memory_order_relaxed) - head);
+    return size <= 0 ? 0 : (size_t)size > buffer_mask_ + 1 ? buffer_mask_ + 1 : (size_t)size;
+  }
+
   size_t capacity() const
   {
     return buffer_mask_ + 1;
   }
 
   bool push(T const& data)
+  {
+    return notify(enqueue(data));
+  }
+
+  bool push(T&& data)
+  {
+    return notify(enqueue(std::move(data)));
+  }
+
+  template<typename... Args>
+  bool emplace(Args&&... args)
+  {
+    return notify(enqueue(std::forward<Args>(args)...));
+  }
+
+  bool pop(T& data)
+  {
+    return notify(dequeue(data));
+  }
+
+  template<class Rep, class Period>
+  bool try_push_for(T const& data, std::chrono::duration<Rep, Period> const& timeout)
+  {
+    return try_push_until(data, std::chrono::steady_clock::now() + timeout);
+  }
+
+  template<class Clock, class Duration>
+  bool try_push_until(T const& data, std::chrono::time_point<Clock, Duration> const& deadline)
+  {
+    return Backoffs::retry(backoff_, [&]() {return enqueue(data);}, deadline);
+  }
+
+  template<class Rep, class Period>
+  bool try_pop_for(T& data, std::chrono::duration<Rep, Period> const& timeout)
+  {
+    return try_pop_until(data, std::chrono::steady_clock::now() + timeout);
+  }
+
+  template<class Clock, class Duration>
+  bool try_pop_until(T& data, std::chrono::time_point<Clock, Duration> const& deadline)
+  {
+    return Backoffs::retry(backoff_, [&]() {return dequeue(data);}, deadline);
+  }
+
+private:
+  template<typename... Args>
+  bool enqueue(Args&&... args)
   {
     cell_t* cell;
     size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
@@ -81,12 +144,12 @@ public:
       else
         pos = enqueue_pos_.load(std::memory_order_relaxed);
     }
-    cell->data_ = data;
+    new (&cell->data_) T(std::forward<Args>(args)...);
     cell->sequence_.store(pos + 1, std::memory_order_release);
     return true;
   }
 
-  bool pop(T& data)
+  bool dequeue(T& data)
   {
     cell_t* cell;
     size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
@@ -107,12 +170,21 @@ public:
       else
         pos = dequeue_pos_.load(std::memory_order_relaxed);
     }
-    data = cell->data_;
+    data = std::move(cell->data_);
+    cell->data_.~T();
     cell->sequence_.store
       (pos + buffer_mask_ + 1, std::memory_order_release);
     return true;
   }
 
+  // a success is notified after the operation, Backoffs::retry notifies on its own
+  bool notify(bool done)
+  {
+    if (done)
+      backoff_.notify();
+    return done;
+  }
+
 private:
   struct cell_t
   {
@@ -129,6 +201,7 @@ private:
   cacheline_pad_t         pad2_;
   std::atomic<size_t>     dequeue_pos_;
   cacheline_pad_t         pad3_;
+  B                       backoff_;
   mpmc_bounded_queue(mpmc_bounded_queue const&);
   void operator = (mpmc_bounded_queue const&);
 };